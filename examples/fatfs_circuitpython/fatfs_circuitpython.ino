@@ -23,10 +23,18 @@
 //   If you don't see anything close the serial monitor, press
 //   the board reset buttton, wait a few seconds, then open the
 //   serial monitor again.
+// - When the library is built with ADAFRUIT_QSPI_TRACE=1, the flash
+//   accesses are dumped in hex at the end. Save the lines between the
+//   markers to a file, convert it with `xxd -r -p` and replay it on a
+//   PC with extras/host qspi_replay. The default depth of 256 entries
+//   only keeps the end of this sketch, build with e.g.
+//   ADAFRUIT_QSPI_TRACE_DEPTH=4096 (80KB of RAM) so that the trace still
+//   holds the begin() setup.
 #include <SPI.h>
 #include <Adafruit_SPIFlash.h>
 #include <Adafruit_SPIFlash_FatFs.h>
 #include "Adafruit_QSPI_Flash.h"
+#include "Adafruit_QSPI_Trace.h"
 
 Adafruit_QSPI_Flash flash;
 
@@ -104,7 +112,25 @@ void setup() {
   }
 
   Serial.println("Finished!");
+
+#if ADAFRUIT_QSPI_TRACE
+  Serial.println("-- trace --");
+  qspi_trace_dump(print_hex, NULL);
+  Serial.println("-- end --");
+#endif
+}
+
+#if ADAFRUIT_QSPI_TRACE
+void print_hex(uint8_t const* data, uint32_t len, void* arg) {
+  (void) arg;
+  for (uint32_t i = 0; i < len; i++) {
+    if (data[i] < 0x10) Serial.print('0');
+    Serial.print(data[i], HEX);
+    if ((i % 32) == 31) Serial.println();
+  }
+  Serial.println();
 }
+#endif
 
 void loop() {
   // Nothing to do in the loop.
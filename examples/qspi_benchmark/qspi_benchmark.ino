@@ -0,0 +1,253 @@
+/* Measure QSPI flash performance: sequential and random read throughput at
+ * several transfer sizes, page program throughput, status poll and small
+ * read8/16/32 latency at each clock setting, then sector, block and chip
+ * erase latency.
+ *
+ * Results are printed one record per line, as CSV (with a header line) or
+ * as JSON lines, so that runs on different boards or library versions can
+ * be collected and compared by a script. Fields:
+ *   version   library version
+ *   board     samd51 or nrf52840
+ *   jedec     flash JEDEC ID
+ *   clock_mhz requested SCK frequency, the port may round it down
+ *   test      seq_read, rand_read, program, status, read8, read16, read32,
+ *             erase_sector, erase_block, erase_chip
+ *   size      bytes per operation
+ *   count     number of operations
+ *   total_us  time of all operations
+ *   op_us     average time per operation
+ *   max_us    longest operation, 0 if not measured
+ *   mb_s      throughput in MB/s (10^6 bytes per second), 0 if not relevant
+ *
+ * WARNING: the program and erase tests destroy the first 64KB of the flash
+ * (the whole chip with BENCH_CHIP_ERASE), e.g the CircuitPython filesystem.
+ */
+
+#include "Adafruit_QSPI_Flash.h"
+
+// 1 for JSON lines, 0 for CSV
+#define BENCH_JSON          0
+
+// Chip erase takes from several seconds to a few minutes
+#define BENCH_CHIP_ERASE    0
+
+// Bytes moved by each read test
+#define BENCH_READ_BYTES    (128*1024UL)
+
+// Operations of each latency test
+#define BENCH_LATENCY_COUNT 1000
+
+// Sectors erased by the sector erase test
+#define BENCH_ERASE_SECTORS 8
+
+#if defined(__SAMD51__)
+  #define BENCH_BOARD   "samd51"
+#elif defined(NRF52840_XXAA)
+  #define BENCH_BOARD   "nrf52840"
+#else
+  #define BENCH_BOARD   "unknown"
+#endif
+
+Adafruit_QSPI_Flash flash;
+
+const uint32_t readSizes[] = { 4, 16, 64, 256, 1024, 4096 };
+const uint32_t clocksMHz[] = { 4, 8, 16, 24, 32, 48, 60, 80, 104, 133 };
+
+uint8_t buf[4096];
+
+char jedec[7];
+uint32_t clockMHz;
+uint32_t randState = 1;
+
+uint32_t randNext() {
+  // xorshift32, same sequence on every board
+  randState ^= randState << 13;
+  randState ^= randState >> 17;
+  randState ^= randState << 5;
+  return randState;
+}
+
+// Random address of a size-aligned operation anywhere in the flash
+uint32_t randAddr(uint32_t size) {
+  return (randNext() % (flash.getFlashDevice()->total_size / size)) * size;
+}
+
+void printHeader() {
+#if !BENCH_JSON
+  Serial.println("version,board,jedec,clock_mhz,test,size,count,total_us,op_us,max_us,mb_s");
+#endif
+}
+
+void report(const char* test, uint32_t size, uint32_t count, uint32_t totalUs, uint32_t maxUs, bool throughput) {
+  float opUs = count ? (float) totalUs / count : 0;
+  float mbs = (throughput && totalUs) ? (float) size * count / totalUs : 0;
+
+#if BENCH_JSON
+  Serial.print("{\"version\":\""); Serial.print(ADAFRUIT_QSPI_VERSION);
+  Serial.print("\",\"board\":\""); Serial.print(BENCH_BOARD);
+  Serial.print("\",\"jedec\":\""); Serial.print(jedec);
+  Serial.print("\",\"clock_mhz\":"); Serial.print(clockMHz);
+  Serial.print(",\"test\":\""); Serial.print(test);
+  Serial.print("\",\"size\":"); Serial.print(size);
+  Serial.print(",\"count\":"); Serial.print(count);
+  Serial.print(",\"total_us\":"); Serial.print(totalUs);
+  Serial.print(",\"op_us\":"); Serial.print(opUs, 3);
+  Serial.print(",\"max_us\":"); Serial.print(maxUs);
+  Serial.print(",\"mb_s\":"); Serial.print(mbs, 3);
+  Serial.println("}");
+#else
+  Serial.print(ADAFRUIT_QSPI_VERSION); Serial.print(',');
+  Serial.print(BENCH_BOARD); Serial.print(',');
+  Serial.print(jedec); Serial.print(',');
+  Serial.print(clockMHz); Serial.print(',');
+  Serial.print(test); Serial.print(',');
+  Serial.print(size); Serial.print(',');
+  Serial.print(count); Serial.print(',');
+  Serial.print(totalUs); Serial.print(',');
+  Serial.print(opUs, 3); Serial.print(',');
+  Serial.print(maxUs); Serial.print(',');
+  Serial.println(mbs, 3);
+#endif
+}
+
+void benchRead(bool sequential) {
+  for (uint32_t i = 0; i < sizeof(readSizes)/sizeof(readSizes[0]); i++) {
+    uint32_t size = readSizes[i];
+    uint32_t count = BENCH_READ_BYTES / size;
+    uint32_t addr = 0;
+    uint32_t maxUs = 0;
+
+    randState = 1;
+    uint32_t start = micros();
+
+    for (uint32_t n = 0; n < count; n++) {
+      uint32_t opStart = micros();
+      flash.readBuffer(sequential ? addr : randAddr(size), buf, size);
+      uint32_t us = micros() - opStart;
+      if (us > maxUs) maxUs = us;
+      addr += size;
+    }
+
+    report(sequential ? "seq_read" : "rand_read", size, count, micros() - start, maxUs, true);
+  }
+}
+
+void benchProgram() {
+  const uint32_t pages = Adafruit_QSPI_Flash::QSPI_FLASH_BLOCK_SIZE / Adafruit_QSPI_Flash::QSPI_FLASH_PAGE_SIZE;
+
+  flash.eraseBlock(0);
+  flash.sync();
+
+  for (uint32_t i = 0; i < sizeof(buf); i++) buf[i] = i;
+
+  uint32_t maxUs = 0;
+  uint32_t start = micros();
+
+  // Program time is waited for by the next page, and by sync() for the last one
+  for (uint32_t n = 0; n < pages; n++) {
+    uint32_t opStart = micros();
+    flash.writeBuffer(n * Adafruit_QSPI_Flash::QSPI_FLASH_PAGE_SIZE, buf, Adafruit_QSPI_Flash::QSPI_FLASH_PAGE_SIZE);
+    uint32_t us = micros() - opStart;
+    if (us > maxUs) maxUs = us;
+  }
+  flash.sync();
+
+  report("program", Adafruit_QSPI_Flash::QSPI_FLASH_PAGE_SIZE, pages, micros() - start, maxUs, true);
+}
+
+void benchLatency() {
+  uint32_t start = micros();
+  for (uint32_t n = 0; n < BENCH_LATENCY_COUNT; n++) flash.readStatus();
+  report("status", 1, BENCH_LATENCY_COUNT, micros() - start, 0, false);
+
+  volatile uint32_t sink = 0;
+
+  randState = 1;
+  start = micros();
+  for (uint32_t n = 0; n < BENCH_LATENCY_COUNT; n++) sink += flash.read8(randAddr(1));
+  report("read8", 1, BENCH_LATENCY_COUNT, micros() - start, 0, true);
+
+  randState = 1;
+  start = micros();
+  for (uint32_t n = 0; n < BENCH_LATENCY_COUNT; n++) sink += flash.read16(randAddr(2));
+  report("read16", 2, BENCH_LATENCY_COUNT, micros() - start, 0, true);
+
+  randState = 1;
+  start = micros();
+  for (uint32_t n = 0; n < BENCH_LATENCY_COUNT; n++) sink += flash.read32(randAddr(4));
+  report("read32", 4, BENCH_LATENCY_COUNT, micros() - start, 0, true);
+}
+
+// Erase time is waited for by sync()
+uint32_t timeErase(bool (*erase)(uint32_t), uint32_t number) {
+  uint32_t start = micros();
+  erase(number);
+  flash.sync();
+  return micros() - start;
+}
+
+bool eraseSector(uint32_t number) { return flash.eraseSector(number); }
+bool eraseBlock(uint32_t number) { return flash.eraseBlock(number); }
+
+void benchErase() {
+  uint32_t total = 0, maxUs = 0;
+
+  for (uint32_t n = 0; n < BENCH_ERASE_SECTORS; n++) {
+    uint32_t us = timeErase(eraseSector, n);
+    total += us;
+    if (us > maxUs) maxUs = us;
+  }
+  report("erase_sector", Adafruit_QSPI_Flash::QSPI_FLASH_SECTOR_SIZE, BENCH_ERASE_SECTORS, total, maxUs, true);
+
+  uint32_t us = timeErase(eraseBlock, 0);
+  report("erase_block", Adafruit_QSPI_Flash::QSPI_FLASH_BLOCK_SIZE, 1, us, us, true);
+
+#if BENCH_CHIP_ERASE
+  uint32_t start = micros();
+  flash.chipErase();
+  flash.sync();
+  us = micros() - start;
+  report("erase_chip", flash.getFlashDevice()->total_size, 1, us, us, true);
+#endif
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+    delay(10);
+  }
+
+  if (!flash.begin()) {
+    Serial.println("Could not find flash on QSPI bus!");
+    while (1);
+  }
+
+  uint32_t id = flash.GetJEDECID();
+  for (int i = 0; i < 6; i++) {
+    jedec[i] = "0123456789abcdef"[(id >> (20 - 4*i)) & 0x0f];
+  }
+
+  printHeader();
+
+  uint32_t maxMHz = flash.getFlashDevice()->max_clock_speed_mhz;
+
+  for (uint32_t i = 0; i < sizeof(clocksMHz)/sizeof(clocksMHz[0]) && clocksMHz[i] <= maxMHz; i++) {
+    clockMHz = clocksMHz[i];
+    QSPI0.setClockSpeed(clockMHz * 1000000UL);
+
+    benchRead(true);
+    benchRead(false);
+    benchProgram();
+    benchLatency();
+  }
+
+  // Erase time does not depend on the clock, measured at the fastest one
+  benchErase();
+
+  Serial.println(BENCH_JSON ? "{\"done\":true}" : "# done");
+}
+
+void loop() {
+  // Nothing to do in the loop.
+  delay(100);
+}
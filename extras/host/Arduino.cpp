@@ -0,0 +1,67 @@
+/**
+ * @file Arduino.cpp
+ *
+ * Simulated-time implementation of the host Arduino API subset.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+
+static uint64_t _time_us = 0;
+
+uint64_t host_time_us(void)
+{
+  return _time_us;
+}
+
+void host_advance_us(uint64_t us)
+{
+  _time_us += us;
+}
+
+void delay(uint32_t ms)
+{
+  _time_us += 1000ULL*ms;
+}
+
+void delayMicroseconds(uint32_t us)
+{
+  _time_us += us;
+}
+
+uint32_t millis(void)
+{
+  return (uint32_t) (_time_us / 1000);
+}
+
+uint32_t micros(void)
+{
+  return (uint32_t) _time_us;
+}
+
+void yield(void)
+{
+  // Spinning on yield() must still make progress in simulated time
+  _time_us += 1;
+}
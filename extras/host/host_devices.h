@@ -0,0 +1,71 @@
+/**
+ * @file host_devices.h
+ *
+ * Flash devices of external_flash_device.h by name, for the -d option of
+ * the host tools.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef HOST_DEVICES_H_
+#define HOST_DEVICES_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "external_flash_device.h"
+
+#define HOST_DEVICE(x)   { #x, x }
+
+static const struct
+{
+  const char* name;
+  external_flash_device dev;
+} host_devices[] =
+{
+  HOST_DEVICE(AT25DF081A), HOST_DEVICE(GD25Q16C), HOST_DEVICE(GD25Q64C), HOST_DEVICE(S25FL064L),
+  HOST_DEVICE(S25FL116K), HOST_DEVICE(S25FL216K), HOST_DEVICE(W25Q16FW), HOST_DEVICE(W25Q16JV_IQ),
+  HOST_DEVICE(W25Q16JV_IM), HOST_DEVICE(W25Q32BV), HOST_DEVICE(W25Q32JV_IM), HOST_DEVICE(W25Q64JV_IM),
+  HOST_DEVICE(W25Q64JV_IQ), HOST_DEVICE(W25Q80DL), HOST_DEVICE(W25Q128JV_SQ), HOST_DEVICE(W25Q256JV_IQ),
+  HOST_DEVICE(MX25L1606), HOST_DEVICE(MX25L3233F), HOST_DEVICE(MX25R6435F), HOST_DEVICE(W25Q128JV_PM),
+  HOST_DEVICE(W25Q32FV),
+};
+
+/// @return device called name, exits with the list of names if unknown
+static inline external_flash_device const* host_find_device(const char* name)
+{
+  size_t const count = sizeof(host_devices)/sizeof(host_devices[0]);
+
+  for ( size_t i = 0; i < count; i++ )
+  {
+    if ( !strcmp(name, host_devices[i].name) ) return &host_devices[i].dev;
+  }
+
+  fprintf(stderr, "unknown device %s, one of:", name);
+  for ( size_t i = 0; i < count; i++ ) fprintf(stderr, " %s", host_devices[i].name);
+  fprintf(stderr, "\n");
+  exit(2);
+}
+
+#endif /* HOST_DEVICES_H_ */
@@ -0,0 +1,57 @@
+/**
+ * @file Adafruit_SPIFlash.h
+ *
+ * Host stand-in for the Adafruit_SPIFlash base class. Only the members that
+ * Adafruit_QSPI_Flash derives from or fills in are declared here; on the
+ * boards the real Adafruit SPIFlash library is used instead.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ADAFRUIT_SPIFLASH_H_
+#define ADAFRUIT_SPIFLASH_H_
+
+#include <Arduino.h>
+
+class Adafruit_SPIFlash
+{
+  public:
+    Adafruit_SPIFlash(int8_t ss) : currentAddr(0), totalsize(0), pagesize(0), pages(0), addrsize(24)
+    {
+      (void) ss;
+    }
+    virtual ~Adafruit_SPIFlash() {}
+
+    virtual uint32_t GetJEDECID(void) = 0;
+    virtual uint32_t readBuffer (uint32_t address, uint8_t *buffer, uint32_t len) = 0;
+    virtual uint32_t writeBuffer(uint32_t address, uint8_t *buffer, uint32_t len) = 0;
+    virtual bool     EraseSector(uint32_t sectorNumber) = 0;
+
+    uint32_t currentAddr;
+    uint32_t totalsize;
+    uint32_t pagesize;
+    uint32_t pages;
+    uint8_t  addrsize;
+};
+
+#endif /* ADAFRUIT_SPIFLASH_H_ */
@@ -0,0 +1,71 @@
+/**
+ * @file Arduino.h
+ *
+ * Minimal subset of the Arduino core API used by Adafruit QSPI, so that the
+ * library can be built and exercised on a Linux host together with the
+ * Adafruit_QSPI_Host port. Time is simulated: delay() and friends advance a
+ * virtual clock instead of sleeping, and the host port advances the same
+ * clock by the modeled bus and flash operation times.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ARDUINO_H_
+#define ARDUINO_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Host builds have no physical pins, these only satisfy Adafruit_QSPI::begin(void)
+#define PIN_QSPI_SCK  0
+#define PIN_QSPI_CS   1
+#define PIN_QSPI_IO0  2
+#define PIN_QSPI_IO1  3
+#define PIN_QSPI_IO2  4
+#define PIN_QSPI_IO3  5
+
+#ifndef min
+#define min(a,b) ((a)<(b)?(a):(b))
+#endif
+
+#ifndef max
+#define max(a,b) ((a)>(b)?(a):(b))
+#endif
+
+void     delay(uint32_t ms);
+void     delayMicroseconds(uint32_t us);
+uint32_t millis(void);
+uint32_t micros(void);
+void     yield(void);
+
+/// Current simulated time in microseconds, never wraps
+uint64_t host_time_us(void);
+
+/// Move simulated time forward
+/// @param us number of microseconds to advance
+void     host_advance_us(uint64_t us);
+
+#endif /* ARDUINO_H_ */
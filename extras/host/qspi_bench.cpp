@@ -0,0 +1,370 @@
+/**
+ * @file qspi_bench.cpp
+ *
+ * Run standard workloads through Adafruit_QSPI_Flash on the simulated host
+ * port, so that driver changes (writeBuffer, polling, caching) can be judged
+ * by numbers before flashing a board.
+ *
+ *   qspi_bench [-d DEVICE] [-c LINES] [-b] [-x] [-w WORKLOAD] [-C]
+ *
+ *   -d  flash model, default W25Q16JV_IQ
+ *   -c  4KiB cache lines used by the rewrite workloads, default 8
+ *   -b  write-back mode of updateBuffer()
+ *   -x  differential write
+ *   -w  run a single workload
+ *   -C  CSV output
+ *
+ * Device time is the simulated clock, including program/erase waits. CPU
+ * time is the host process time, i.e the cost of the driver code itself.
+ * After each workload the flash is read back and compared with the expected
+ * contents, the exit status is non-zero on any failure, mismatch or flash
+ * violation.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "Adafruit_QSPI_Flash.h"
+#include "Adafruit_QSPI_Cache.h"
+#include "host_devices.h"
+
+#include <time.h>
+
+enum
+{
+  BENCH_REGION_MAX   = 1024*1024UL, // bytes of flash used by the workloads
+  BENCH_SECTOR_SIZE  = Adafruit_QSPI_Flash::QSPI_FLASH_SECTOR_SIZE,
+
+  BENCH_LOG_BYTES    = 256*1024UL,
+  BENCH_LOG_RECORD   = 48,
+
+  BENCH_REWRITE_COUNT = 256,
+
+  BENCH_FAT_FILES    = 64,
+  BENCH_FAT_SECTOR   = 512,   // FatFs sector and CircuitPython cluster size
+  BENCH_FAT_FILE_SECTORS = 4,
+  BENCH_FAT_TABLE    = 0x1000,
+  BENCH_FAT_ROOT_DIR = 0x2000,
+  BENCH_FAT_DATA     = 0x4000,
+
+  BENCH_IMAGE_CHUNK  = 4096,
+};
+
+typedef struct
+{
+  uint32_t ops;    // workload level operations, e.g records or sectors written
+  uint64_t bytes;  // bytes written by the workload
+  uint32_t failed; // operations that returned an error
+  uint32_t mismatched; // bytes read back different from what was written
+} bench_result_t;
+
+typedef struct
+{
+  const char* name;
+  void (*run)(bench_result_t* result);
+} bench_workload_t;
+
+static Adafruit_QSPI_Flash flash;
+static Adafruit_QSPI_Cache cache;
+
+static uint32_t region_size;
+static uint8_t  buf[BENCH_IMAGE_CHUNK];
+static uint8_t  expected[BENCH_REGION_MAX]; // flash contents of the region
+static uint32_t rand_state = 1;
+
+// xorshift32, same sequence on every run
+static uint32_t bench_rand(void)
+{
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return rand_state;
+}
+
+static void fill(uint8_t* data, uint32_t len)
+{
+  for ( uint32_t i = 0; i < len; i++ ) data[i] = (uint8_t) bench_rand();
+}
+
+static void account(bench_result_t* result, uint32_t len, bool ok)
+{
+  result->ops++;
+  result->bytes += len;
+  if ( !ok ) result->failed++;
+}
+
+// Expected contents after an erase, a program (clears bits only) and an update
+static void expect_erase(uint32_t addr, uint32_t len)
+{
+  memset(expected + addr, 0xff, len);
+}
+
+static void expect_program(uint32_t addr, uint8_t const* data, uint32_t len)
+{
+  for ( uint32_t i = 0; i < len; i++ ) expected[addr + i] &= data[i];
+}
+
+static void expect_update(uint32_t addr, uint8_t const* data, uint32_t len)
+{
+  memcpy(expected + addr, data, len);
+}
+
+// Read the region back from flash, not from cached lines
+static uint32_t compare_region(void)
+{
+  uint32_t mismatched = 0;
+
+  cache.invalidateAll();
+
+  for ( uint32_t addr = 0; addr < region_size; addr += sizeof(buf) )
+  {
+    if ( flash.readBuffer(addr, buf, sizeof(buf)) != sizeof(buf) ) return region_size;
+
+    for ( uint32_t i = 0; i < sizeof(buf); i++ )
+    {
+      if ( buf[i] != expected[addr + i] ) mismatched++;
+    }
+  }
+
+  return mismatched;
+}
+
+// Fixed size records appended to a log, sectors erased as the log reaches them
+static void bench_log_append(bench_result_t* result)
+{
+  uint32_t erased_end = 0;
+
+  for ( uint32_t addr = 0; addr + BENCH_LOG_RECORD <= BENCH_LOG_BYTES; addr += BENCH_LOG_RECORD )
+  {
+    while ( addr + BENCH_LOG_RECORD > erased_end )
+    {
+      if ( !flash.eraseSector(erased_end / BENCH_SECTOR_SIZE) ) result->failed++;
+      expect_erase(erased_end, BENCH_SECTOR_SIZE);
+      erased_end += BENCH_SECTOR_SIZE;
+    }
+
+    fill(buf, BENCH_LOG_RECORD);
+    account(result, BENCH_LOG_RECORD, flash.appendBuffer(addr, buf, BENCH_LOG_RECORD) == BENCH_LOG_RECORD);
+    expect_program(addr, buf, BENCH_LOG_RECORD);
+  }
+}
+
+// Whole sectors rewritten at random places
+static void bench_random_rewrite(bench_result_t* result)
+{
+  for ( uint32_t n = 0; n < BENCH_REWRITE_COUNT; n++ )
+  {
+    uint32_t const addr = (bench_rand() % (region_size / BENCH_SECTOR_SIZE)) * BENCH_SECTOR_SIZE;
+
+    fill(buf, BENCH_SECTOR_SIZE);
+    account(result, BENCH_SECTOR_SIZE, flash.updateBuffer(addr, buf, BENCH_SECTOR_SIZE) == BENCH_SECTOR_SIZE);
+    expect_update(addr, buf, BENCH_SECTOR_SIZE);
+  }
+}
+
+static void fat_write(bench_result_t* result, uint32_t addr)
+{
+  fill(buf, BENCH_FAT_SECTOR);
+  account(result, BENCH_FAT_SECTOR, flash.updateBuffer(addr, buf, BENCH_FAT_SECTOR) == BENCH_FAT_SECTOR);
+  expect_update(addr, buf, BENCH_FAT_SECTOR);
+}
+
+// Small files created and deleted on a FAT volume with 512 byte clusters:
+// each data sector written is followed by the FAT and directory sectors
+// that FatFs rewrites on f_sync()/f_close()
+static void bench_fat_churn(bench_result_t* result)
+{
+  uint32_t const data_sectors = (region_size - BENCH_FAT_DATA) / BENCH_FAT_SECTOR;
+  uint32_t cluster = 0;
+
+  for ( uint32_t file = 0; file < BENCH_FAT_FILES; file++ )
+  {
+    uint32_t const dir_sector = BENCH_FAT_ROOT_DIR + (file / 16) * BENCH_FAT_SECTOR; // 16 entries per sector
+
+    for ( uint32_t s = 0; s < BENCH_FAT_FILE_SECTORS; s++ )
+    {
+      fat_write(result, BENCH_FAT_DATA + (cluster % data_sectors) * BENCH_FAT_SECTOR);
+
+      // FAT16 entries are 2 bytes, 256 per sector
+      fat_write(result, BENCH_FAT_TABLE + ((cluster % data_sectors) / 256) * BENCH_FAT_SECTOR);
+      cluster++;
+    }
+
+    fat_write(result, dir_sector);
+
+    // Delete every other previous file: its FAT chain and directory entry
+    if ( file & 1 )
+    {
+      fat_write(result, BENCH_FAT_TABLE + (((cluster - 2*BENCH_FAT_FILE_SECTORS) % data_sectors) / 256) * BENCH_FAT_SECTOR);
+      fat_write(result, dir_sector);
+    }
+  }
+}
+
+// Firmware/filesystem image written to a freshly erased region
+static void bench_bulk_image(bench_result_t* result)
+{
+  if ( !flash.eraseRange(0, region_size) ) result->failed++;
+  expect_erase(0, region_size);
+
+  for ( uint32_t addr = 0; addr < region_size; addr += BENCH_IMAGE_CHUNK )
+  {
+    fill(buf, BENCH_IMAGE_CHUNK);
+    account(result, BENCH_IMAGE_CHUNK, flash.writeBuffer(addr, buf, BENCH_IMAGE_CHUNK) == BENCH_IMAGE_CHUNK);
+    expect_program(addr, buf, BENCH_IMAGE_CHUNK);
+  }
+}
+
+static const bench_workload_t workloads[] =
+{
+  { "log_append"    , bench_log_append     },
+  { "random_rewrite", bench_random_rewrite },
+  { "fat_churn"     , bench_fat_churn      },
+  { "bulk_image"    , bench_bulk_image     },
+};
+
+static uint64_t cpu_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: qspi_bench [-d DEVICE] [-c LINES] [-b] [-x] [-w WORKLOAD] [-C]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv)
+{
+  const char* dev_name = "W25Q16JV_IQ";
+  const char* only = NULL;
+  uint32_t cache_lines = 8;
+  bool write_back = false;
+  bool diff_write = false;
+  bool csv = false;
+
+  for ( int i = 1; i < argc; i++ )
+  {
+    bool const has_value = i + 1 < argc;
+
+    if ( !strcmp(argv[i], "-d") && has_value ) dev_name = argv[++i];
+    else if ( !strcmp(argv[i], "-c") && has_value ) cache_lines = strtoul(argv[++i], NULL, 0);
+    else if ( !strcmp(argv[i], "-w") && has_value ) only = argv[++i];
+    else if ( !strcmp(argv[i], "-b") ) write_back = true;
+    else if ( !strcmp(argv[i], "-x") ) diff_write = true;
+    else if ( !strcmp(argv[i], "-C") ) csv = true;
+    else usage();
+  }
+
+  external_flash_device const* dev = host_find_device(dev_name);
+  region_size = min(dev->total_size, (uint32_t) BENCH_REGION_MAX);
+  expect_erase(0, region_size);
+
+  QSPI0.setFlashDevice(dev);
+  if ( !flash.begin() )
+  {
+    fprintf(stderr, "flash begin failed\n");
+    return 1;
+  }
+
+  // updateBuffer() needs a cache of sector lines
+  if ( !cache.begin(cache_lines ? cache_lines : 1, BENCH_SECTOR_SIZE) )
+  {
+    fprintf(stderr, "cannot allocate %u cache lines\n", cache_lines);
+    return 1;
+  }
+  flash.setCache(&cache);
+  flash.setWriteBack(write_back);
+  flash.setDifferentialWrite(diff_write);
+
+  if ( csv )
+  {
+    printf("device,workload,ops,bytes,device_us,transactions,erases,erased_bytes,programmed_bytes,cpu_ns,failed,mismatched,violations\n");
+  }
+  else
+  {
+    printf("%s, %u cache lines%s%s\n\n", dev_name, cache_lines ? cache_lines : 1,
+           write_back ? ", write-back" : "", diff_write ? ", differential write" : "");
+    printf("%-15s %7s %8s %10s %8s %8s %7s %9s %8s %10s %6s %8s\n", "workload", "ops", "MiB", "device_ms", "MB/s",
+           "xfers", "erases", "erase/MiB", "program", "cpu_us/op", "failed", "mismatch");
+  }
+
+  uint32_t total_violations = 0;
+  uint32_t failed_workloads = 0;
+
+  for ( size_t w = 0; w < sizeof(workloads)/sizeof(workloads[0]); w++ )
+  {
+    if ( only && strcmp(only, workloads[w].name) ) continue;
+
+    bench_result_t result = { 0, 0, 0, 0 };
+    rand_state = 1;
+
+    flash.sync();
+    QSPI0.resetCounters();
+    uint32_t const violations = QSPI0.violations();
+
+    uint64_t const start_us = host_time_us();
+    uint64_t const start_ns = cpu_ns();
+
+    workloads[w].run(&result);
+    if ( !flash.sync() ) result.failed++;
+
+    uint64_t const device_us = host_time_us() - start_us;
+    uint64_t const cpu = cpu_ns() - start_ns;
+    uint32_t const transactions = QSPI0.transactions();
+
+    // Not part of the measurement
+    result.mismatched = compare_region();
+
+    uint32_t const new_violations = QSPI0.violations() - violations;
+    total_violations += new_violations;
+    if ( result.failed || result.mismatched || new_violations ) failed_workloads++;
+
+    if ( csv )
+    {
+      printf("%s,%s,%u,%llu,%llu,%u,%u,%llu,%llu,%llu,%u,%u,%u\n", dev_name, workloads[w].name, result.ops,
+             (unsigned long long) result.bytes, (unsigned long long) device_us, transactions, QSPI0.erases(),
+             (unsigned long long) QSPI0.erasedBytes(), (unsigned long long) QSPI0.programmedBytes(),
+             (unsigned long long) cpu, result.failed, result.mismatched, new_violations);
+      continue;
+    }
+
+    double const mib = result.bytes / (1024.0*1024.0);
+
+    // program: bytes programmed in the flash array per byte written
+    printf("%-15s %7u %8.3f %10.1f %8.3f %8u %7u %9.1f %8.2f %10.3f %6u %8u\n", workloads[w].name, result.ops, mib,
+           device_us / 1000.0, device_us ? (double) result.bytes / device_us : 0,
+           transactions, QSPI0.erases(), mib ? QSPI0.erases() / mib : 0,
+           result.bytes ? (double) QSPI0.programmedBytes() / result.bytes : 0,
+           result.ops ? cpu / 1000.0 / result.ops : 0, result.failed, result.mismatched);
+  }
+
+  if ( !csv ) printf("\nviolations: %u\n", total_violations);
+
+  flash.setCache(NULL);
+  cache.end();
+  QSPI0.end();
+
+  return failed_workloads ? 1 : 0;
+}
@@ -0,0 +1,230 @@
+/**
+ * @file qspi_replay.cpp
+ *
+ * Replay a trace captured with ADAFRUIT_QSPI_TRACE through the simulated
+ * host port, to reproduce and profile a field workload without the device.
+ *
+ *   qspi_replay [-d DEVICE] [-f FILE] trace.bin
+ *
+ * DEVICE is the flash model (default W25Q16JV_IQ), FILE an optional backing
+ * file so that the flash contents persist across replays. The trace should
+ * start at begin(): clock and transfer modes are replayed from its
+ * QSPI_TRACE_CONFIG entries. The idle time
+ * between recorded operations is kept, so that program/erase completion
+ * follows the device model; operations that the recorded timing would not
+ * allow on that model show up as violations. The trace holds no payload,
+ * pages are programmed with 0x00.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// before Arduino.h, whose min/max macros break the STL
+#include <vector>
+
+#include "Adafruit_QSPI.h"
+#include "Adafruit_QSPI_Trace.h"
+#include "host_devices.h"
+
+static const char* const type_names[QSPI_TRACE_TYPE_COUNT] =
+{
+  "run", "read_cmd", "write_cmd", "erase", "read_mem", "write_mem", "config"
+};
+
+typedef struct
+{
+  uint32_t count;
+  uint64_t bytes;
+  uint64_t recorded_us;
+  uint64_t replayed_us;
+  uint32_t failed;
+} replay_stats_t;
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: qspi_replay [-d DEVICE] [-f FILE] trace.bin\n");
+  exit(2);
+}
+
+static bool load_trace(const char* path, qspi_trace_header_t* header, std::vector<qspi_trace_entry_t>& entries)
+{
+  FILE* fp = fopen(path, "rb");
+  if ( !fp ) { perror(path); return false; }
+
+  bool ok = fread(header, sizeof(*header), 1, fp) == 1 &&
+            header->magic == QSPI_TRACE_MAGIC && header->version == QSPI_TRACE_VERSION &&
+            header->entry_size == sizeof(qspi_trace_entry_t);
+
+  if ( ok )
+  {
+    entries.resize(header->count);
+    ok = !header->count || fread(entries.data(), sizeof(qspi_trace_entry_t), header->count, fp) == header->count;
+  }
+
+  fclose(fp);
+  if ( !ok ) fprintf(stderr, "%s: not a version %u trace or truncated\n", path, QSPI_TRACE_VERSION);
+
+  return ok;
+}
+
+static bool replay_config(qspi_trace_entry_t const* entry)
+{
+  switch ( entry->opcode )
+  {
+    case QSPI_TRACE_SET_CLOCK:
+      QSPI0.setClockSpeed(entry->addr);
+      return true;
+
+    case QSPI_TRACE_SET_READ_MODE:       return QSPI0.setReadMode(entry->addr, entry->len);
+    case QSPI_TRACE_SET_WRITE_MODE:      return QSPI0.setWriteMode(entry->addr);
+    case QSPI_TRACE_SET_QPI:             return QSPI0.setQPI(entry->addr);
+    case QSPI_TRACE_SET_ADDRESS_LENGTH:  return QSPI0.setAddressLength(entry->addr);
+    case QSPI_TRACE_SET_CONTINUOUS_READ: return QSPI0.setContinuousReadMode(entry->addr);
+
+    default: return false;
+  }
+}
+
+static bool replay(qspi_trace_entry_t const* entry, std::vector<uint8_t>& buf)
+{
+  if ( buf.size() < entry->len ) buf.resize(entry->len);
+
+  switch ( entry->type )
+  {
+    case QSPI_TRACE_RUN_COMMAND:
+      return QSPI0.runCommand(entry->opcode);
+
+    case QSPI_TRACE_READ_COMMAND:
+      return QSPI0.readCommand(entry->opcode, buf.data(), entry->len);
+
+    case QSPI_TRACE_WRITE_COMMAND:
+    {
+      memset(buf.data(), 0, entry->len);
+      for ( uint32_t i = 0; i < entry->len && i < 4; i++ ) buf[i] = (uint8_t) (entry->addr >> (8*i));
+
+      return QSPI0.writeCommand(entry->opcode, entry->len ? buf.data() : NULL, entry->len);
+    }
+
+    case QSPI_TRACE_ERASE_COMMAND:
+      return QSPI0.eraseCommand(entry->opcode, entry->addr);
+
+    case QSPI_TRACE_READ_MEMORY:
+      return QSPI0.readMemory(entry->addr, buf.data(), entry->len);
+
+    case QSPI_TRACE_WRITE_MEMORY:
+      memset(buf.data(), 0, entry->len);
+      return QSPI0.writeMemory(entry->addr, buf.data(), entry->len);
+
+    case QSPI_TRACE_CONFIG:
+      return replay_config(entry);
+
+    default: return false;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  const char* dev_name = "W25Q16JV_IQ";
+  const char* backing_file = NULL;
+  int i;
+
+  for ( i = 1; i < argc && argv[i][0] == '-'; i++ )
+  {
+    if ( i + 1 >= argc ) usage();
+
+    if ( !strcmp(argv[i], "-d") ) dev_name = argv[++i];
+    else if ( !strcmp(argv[i], "-f") ) backing_file = argv[++i];
+    else usage();
+  }
+  if ( i + 1 != argc ) usage();
+
+  external_flash_device const* dev = host_find_device(dev_name);
+
+  qspi_trace_header_t header;
+  std::vector<qspi_trace_entry_t> entries;
+  if ( !load_trace(argv[i], &header, entries) ) return 1;
+
+  QSPI0.setFlashDevice(dev);
+  if ( backing_file && !QSPI0.setBackingFile(backing_file) )
+  {
+    fprintf(stderr, "%s: cannot map\n", backing_file);
+    return 1;
+  }
+  QSPI0.begin();
+
+  // The ring overwrote the oldest entries: without the begin() setup the
+  // replay runs with the port's default clock and transfer modes
+  if ( header.dropped )
+  {
+    bool has_setup = false;
+    for ( size_t n = 0; n < entries.size() && !has_setup; n++ ) has_setup = (entries[n].type == QSPI_TRACE_CONFIG);
+
+    if ( !has_setup )
+    {
+      fprintf(stderr, "warning: %u entries dropped including the begin() setup, replaying with default clock and "
+                      "transfer modes. Capture with a larger ADAFRUIT_QSPI_TRACE_DEPTH.\n", header.dropped);
+    }
+  }
+
+  replay_stats_t stats[QSPI_TRACE_TYPE_COUNT];
+  memset(stats, 0, sizeof(stats));
+
+  std::vector<uint8_t> buf;
+  uint64_t const replay_start = host_time_us();
+
+  for ( size_t n = 0; n < entries.size(); n++ )
+  {
+    qspi_trace_entry_t const* entry = &entries[n];
+    if ( entry->type >= QSPI_TRACE_TYPE_COUNT ) continue;
+
+    // Keep the idle time the application spent between operations
+    if ( n ) host_advance_us((uint32_t) (entry->start_us - entries[n-1].end_us));
+
+    uint64_t const start = host_time_us();
+    bool const ok = replay(entry, buf);
+
+    replay_stats_t* st = &stats[entry->type];
+    st->count++;
+    if ( entry->type != QSPI_TRACE_CONFIG ) st->bytes += entry->len;
+    st->recorded_us += (uint32_t) (entry->end_us - entry->start_us);
+    st->replayed_us += host_time_us() - start;
+    if ( !ok ) st->failed++;
+  }
+
+  uint64_t const recorded_span = entries.empty() ? 0 : (uint32_t) (entries.back().end_us - entries.front().start_us);
+
+  printf("%u entries replayed on %s, %u dropped at capture\n\n", header.count, dev_name, header.dropped);
+  printf("%-10s %8s %10s %12s %12s %6s\n", "op", "count", "bytes", "recorded_us", "replayed_us", "failed");
+  for ( int t = 0; t < QSPI_TRACE_TYPE_COUNT; t++ )
+  {
+    replay_stats_t const* st = &stats[t];
+    printf("%-10s %8u %10llu %12llu %12llu %6u\n", type_names[t], st->count, (unsigned long long) st->bytes,
+           (unsigned long long) st->recorded_us, (unsigned long long) st->replayed_us, st->failed);
+  }
+
+  printf("\nspan: recorded %llu us, replayed %llu us\n", (unsigned long long) recorded_span,
+         (unsigned long long) (host_time_us() - replay_start));
+  printf("violations: %u\n", QSPI0.violations());
+
+  QSPI0.end();
+  return QSPI0.violations() ? 1 : 0;
+}
@@ -0,0 +1,827 @@
+/**
+ * @file qspi_test.cpp
+ *
+ * Checks Adafruit_QSPI_Flash against a RAM model of the flash contents on
+ * the simulated host port. Every case also fails on any flash violation,
+ * e.g a program without Write Enable or a read while busy.
+ *
+ *   qspi_test [CASE]
+ *
+ * Exits non-zero if any case fails, see "make test". In a
+ * -DADAFRUIT_QSPI_TRACE=1 build the trace case writes its capture to the file
+ * named by QSPI_TEST_TRACE (default qspi_trace.bin) for qspi_replay.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "Adafruit_QSPI_Flash.h"
+#include "Adafruit_QSPI_Cache.h"
+#include "Adafruit_QSPI_CRC32.h"
+#include "Adafruit_QSPI_FlashT.h"
+#include "Adafruit_QSPI_Stats.h"
+#include "Adafruit_QSPI_Trace.h"
+#include "host_devices.h"
+
+enum
+{
+  TEST_REGION      = 64*1024UL, // bytes of flash compared with the model
+  TEST_SECTOR_SIZE = Adafruit_QSPI_Flash::QSPI_FLASH_SECTOR_SIZE,
+  TEST_PAGE_SIZE   = Adafruit_QSPI_Flash::QSPI_FLASH_PAGE_SIZE,
+  TEST_OPS         = 20000,
+};
+
+typedef struct
+{
+  const char* name;
+  void (*run)(void);
+} test_case_t;
+
+static uint32_t failures;
+static uint32_t expected_violations; // provoked by the case on purpose
+static uint8_t  model[TEST_REGION];
+static uint8_t  buf[TEST_REGION];
+static uint32_t rand_state;
+
+#define CHECK(cond) \
+  do { \
+    if ( !(cond) ) { failures++; fprintf(stderr, "  %s:%d: %s\n", __FILE__, __LINE__, #cond); } \
+  } while(0)
+
+// xorshift32, same sequence on every run
+static uint32_t test_rand(void)
+{
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return rand_state;
+}
+
+static void fill(uint8_t* data, uint32_t len)
+{
+  for ( uint32_t i = 0; i < len; i++ ) data[i] = (uint8_t) test_rand();
+}
+
+// Fresh blank chip and a cold begin()
+static bool start(Adafruit_QSPI_Flash* flash, const char* dev_name)
+{
+  QSPI0.end();
+  QSPI0.setFlashDevice(host_find_device(dev_name));
+  memset(model, 0xff, sizeof(model));
+
+  return flash->begin();
+}
+
+static bool same_jedec_id(external_flash_device const* a, external_flash_device const* b)
+{
+  return a && b && a->manufacturer_id == b->manufacturer_id && a->memory_type == b->memory_type &&
+         a->capacity == b->capacity;
+}
+
+// Flash contents of the region must match the model
+static void check_region(Adafruit_QSPI_Flash* flash)
+{
+  CHECK(flash->readBuffer(0, buf, TEST_REGION) == TEST_REGION);
+  CHECK(!memcmp(buf, model, TEST_REGION));
+}
+
+//--------------------------------------------------------------------+
+// Cases
+//--------------------------------------------------------------------+
+
+// Page program of more than 256 bytes keeps the last 256 bytes, wrapped
+// around inside the page of the start address
+static void test_port_page_wrap(void)
+{
+  Adafruit_QSPI_Flash flash;
+  CHECK(start(&flash, "W25Q16JV_IQ"));
+
+  uint8_t data[300];
+  fill(data, sizeof(data));
+
+  CHECK(flash.writeEnable());
+  CHECK(QSPI0.writeMemory(250, data, sizeof(data)));
+
+  // The driver did not start this program, wait it out before reading
+  host_advance_us(100000);
+  CHECK(flash.readBuffer(0, buf, 2*TEST_PAGE_SIZE) == 2*TEST_PAGE_SIZE);
+
+  // data[44 + i] goes to offset (250 + 44 + i) % 256 of page 0
+  for ( uint32_t i = 0; i < TEST_PAGE_SIZE; i++ ) model[(250 + 44 + i) % TEST_PAGE_SIZE] = data[44 + i];
+  CHECK(!memcmp(buf, model, 2*TEST_PAGE_SIZE));
+}
+
+// Random erases, programs and reads through writeBuffer()/readBuffer(),
+// with no cache, FatFs sized and sector sized cache lines
+static void random_ops(uint32_t line_size)
+{
+  Adafruit_QSPI_Flash flash;
+  Adafruit_QSPI_Cache cache;
+  CHECK(start(&flash, "W25Q64JV_IQ"));
+  CHECK(flash.eraseRange(0, TEST_REGION));
+
+  if ( line_size )
+  {
+    CHECK(cache.begin(8, line_size));
+    flash.setCache(&cache);
+  }
+
+  for ( uint32_t n = 0; n < TEST_OPS; n++ )
+  {
+    uint32_t const op = test_rand() % 100;
+    uint32_t addr = test_rand() % (TEST_REGION - 300);
+
+    if ( op < 2 )
+    {
+      uint32_t const sector = addr / TEST_SECTOR_SIZE;
+      CHECK(flash.eraseSector(sector));
+      memset(model + sector*TEST_SECTOR_SIZE, 0xff, TEST_SECTOR_SIZE);
+    }
+    else if ( op < 10 )
+    {
+      uint8_t data[300];
+      uint32_t const len = 1 + test_rand() % sizeof(data);
+      fill(data, len);
+
+      CHECK(flash.writeBuffer(addr, data, len) == len);
+      for ( uint32_t i = 0; i < len; i++ ) model[addr + i] &= data[i];
+    }
+    else
+    {
+      uint8_t data[300];
+      uint32_t const len = 1 + test_rand() % (op < 50 ? 16 : sizeof(data));
+
+      CHECK(flash.readBuffer(addr, data, len) == len);
+      CHECK(!memcmp(data, model + addr, len));
+    }
+  }
+
+  flash.setCache(NULL);
+  check_region(&flash);
+}
+
+static void test_random(void)       { random_ops(0); }
+static void test_cache_512(void)    { random_ops(512); }
+static void test_cache_4096(void)   { random_ops(4096); }
+
+// Read-modify-write updates through the sector cache, write-through or
+// write-back, with and without differential write
+static void updates(bool write_back, bool diff_write)
+{
+  Adafruit_QSPI_Flash flash;
+  Adafruit_QSPI_Cache cache;
+  CHECK(start(&flash, "W25Q64JV_IQ"));
+  CHECK(cache.begin(4, TEST_SECTOR_SIZE));
+  flash.setCache(&cache);
+  CHECK(flash.setWriteBack(write_back));
+  flash.setDifferentialWrite(diff_write);
+
+  for ( uint32_t n = 0; n < TEST_OPS; n++ )
+  {
+    uint32_t const op = test_rand() % 100;
+    uint32_t const addr = test_rand() % (TEST_REGION - 300);
+    uint8_t data[300];
+
+    if ( op < 15 )
+    {
+      uint32_t const len = 1 + test_rand() % 64;
+      fill(data, len);
+
+      CHECK(flash.updateBuffer(addr, data, len) == len);
+      memcpy(model + addr, data, len);
+    }
+    else if ( op < 16 )
+    {
+      CHECK(flash.sync());
+    }
+    else
+    {
+      uint32_t const len = 1 + test_rand() % sizeof(data);
+
+      CHECK(flash.readBuffer(addr, data, len) == len);
+      CHECK(!memcmp(data, model + addr, len));
+    }
+
+    flash.task();
+    host_advance_us(100);
+  }
+
+  CHECK(flash.sync());
+  flash.setCache(NULL);
+  check_region(&flash);
+}
+
+static void test_update(void)            { updates(false, false); }
+static void test_write_back(void)        { updates(true, false); }
+static void test_write_back_diff(void)   { updates(true, true); }
+
+// Appended records interleaved with unaligned writes and reads
+static void test_append(void)
+{
+  Adafruit_QSPI_Flash flash;
+  CHECK(start(&flash, "W25Q64JV_IQ"));
+  CHECK(flash.eraseRange(0, TEST_REGION));
+
+  uint32_t append_addr = 0;
+
+  for ( uint32_t n = 0; n < TEST_OPS; n++ )
+  {
+    uint32_t const op = test_rand() % 100;
+    uint32_t const addr = test_rand() % (TEST_REGION - 300);
+    uint8_t data[300];
+
+    if ( op < 20 )
+    {
+      uint32_t const len = 16 + test_rand() % 49;
+      if ( test_rand() % 20 == 0 || append_addr + len > TEST_REGION ) append_addr = test_rand() % (TEST_REGION - 4096);
+      fill(data, len);
+
+      CHECK(flash.appendBuffer(append_addr, data, len) == len);
+      for ( uint32_t i = 0; i < len; i++ ) model[append_addr + i] &= data[i];
+      append_addr += len;
+    }
+    else if ( op < 25 )
+    {
+      uint32_t const len = 1 + test_rand() % sizeof(data);
+      fill(data, len);
+
+      CHECK(flash.writeBuffer(addr, data, len) == len);
+      for ( uint32_t i = 0; i < len; i++ ) model[addr + i] &= data[i];
+    }
+    else
+    {
+      uint32_t const len = 1 + test_rand() % sizeof(data);
+
+      CHECK(flash.readBuffer(addr, data, len) == len);
+      CHECK(!memcmp(data, model + addr, len));
+    }
+  }
+
+  CHECK(flash.sync());
+  check_region(&flash);
+}
+
+// eraseRange() of random sector aligned ranges, with and without the blank check
+static void test_erase_range(void)
+{
+  Adafruit_QSPI_Flash flash;
+  CHECK(start(&flash, "W25Q16JV_IQ"));
+
+  uint32_t const sectors = TEST_REGION / TEST_SECTOR_SIZE;
+  uint8_t zeros[64];
+  memset(zeros, 0, sizeof(zeros));
+
+  // Program everything so that missed erases show
+  for ( uint32_t addr = 0; addr < TEST_REGION; addr += sizeof(zeros) ) flash.writeBuffer(addr, zeros, sizeof(zeros));
+  memset(model, 0, sizeof(model));
+
+  for ( uint32_t n = 0; n < 200; n++ )
+  {
+    uint32_t const first = test_rand() % sectors;
+    uint32_t const count = 1 + test_rand() % (sectors - first);
+
+    CHECK(flash.eraseRange(first*TEST_SECTOR_SIZE, count*TEST_SECTOR_SIZE, test_rand() & 1));
+    memset(model + first*TEST_SECTOR_SIZE, 0xff, count*TEST_SECTOR_SIZE);
+
+    uint32_t const addr = test_rand() % (TEST_REGION - sizeof(zeros));
+    flash.writeBuffer(addr, zeros, sizeof(zeros));
+    memset(model + addr, 0, sizeof(zeros));
+  }
+
+  // A range larger than a block is planned with block erases
+  CHECK(flash.eraseRange(0, TEST_REGION));
+  memset(model, 0xff, sizeof(model));
+
+  check_region(&flash);
+}
+
+// isErased(), verify() and crc32() scans
+static void test_scans(void)
+{
+  Adafruit_QSPI_Flash flash;
+  CHECK(start(&flash, "W25Q64JV_IQ"));
+  CHECK(flash.eraseRange(0, 2*TEST_REGION));
+
+  uint32_t const len = TEST_REGION - 100;
+  fill(model, len);
+
+  CHECK(flash.isErased(3, TEST_REGION));
+  CHECK(flash.writeBuffer(5, model, len) == len);
+
+  CHECK(!flash.isErased(3, 100));
+  CHECK(flash.isErased(5 + len, 1000));
+
+  CHECK(flash.verify(5, model, len));
+  model[len/2] ^= 1;
+  CHECK(!flash.verify(5, model, len));
+  model[len/2] ^= 1;
+
+  uint32_t const crc = flash.crc32(5, len);
+  CHECK(crc == qspi_crc32(0, model, len));
+  CHECK(flash.crc32(5 + 500, len - 500, flash.crc32(5, 500)) == crc);
+}
+
+// Reads during a block erase are served by suspending the erase
+static void test_erase_suspend(void)
+{
+  Adafruit_QSPI_Flash flash;
+  CHECK(start(&flash, "W25Q64JV_IQ"));
+
+  uint32_t const addr = 200000;
+  fill(model, 512);
+  CHECK(flash.writeBuffer(addr, model, 512) == 512);
+
+  for ( uint32_t round = 0; round < 3; round++ )
+  {
+    CHECK(flash.eraseBlock(0));
+
+    for ( uint32_t n = 0; n < 100; n++ )
+    {
+      CHECK(flash.readBuffer(addr, buf, 512) == 512);
+      CHECK(!memcmp(buf, model, 512));
+      host_advance_us(500);
+    }
+
+    CHECK(flash.sync());
+    CHECK(flash.isErased(0, 64*1024UL));
+  }
+}
+
+// Fixed size reads return the data, all ones if the read fails
+static void test_read_int(void)
+{
+  Adafruit_QSPI_Flash flash;
+  CHECK(start(&flash, "W25Q16JV_IQ"));
+
+  uint8_t data[] = { 0x12, 0x34, 0x56, 0x78 };
+  CHECK(flash.writeBuffer(100, data, sizeof(data)) == sizeof(data));
+
+  CHECK(flash.read8(100) == 0x12);
+  CHECK(flash.read16(100) == 0x3412);
+  CHECK(flash.read32(100) == 0x78563412UL);
+
+  uint32_t const end = flash.getFlashDevice()->total_size;
+  CHECK(flash.read8(end) == 0xff);
+  CHECK(flash.read16(end) == 0xffff);
+  CHECK(flash.read32(end) == 0xffffffffUL);
+}
+
+static void count_callback(bool result, void* arg)
+{
+  if ( result ) (*(uint32_t*) arg)++;
+}
+
+// Asynchronous API of the port: callbacks only from task(), one operation at
+// a time, blocking calls still work while busy()
+static void test_async(void)
+{
+  Adafruit_QSPI_Flash flash;
+  CHECK(start(&flash, "W25Q16JV_IQ"));
+
+  uint32_t done = 0;
+  fill(model, 256);
+  CHECK(flash.writeBuffer(0, model, 256) == 256);
+  CHECK(flash.sync());
+
+  // Read: data right away, callback deferred
+  memset(buf, 0, 256);
+  CHECK(QSPI0.readMemoryAsync(0, buf, 256, count_callback, &done));
+  CHECK(QSPI0.busy());
+  CHECK(done == 0);
+  CHECK(!QSPI0.readMemoryAsync(0, buf, 256, count_callback, &done));
+  QSPI0.task();
+  CHECK(!QSPI0.busy());
+  CHECK(done == 1);
+  CHECK(!memcmp(buf, model, 256));
+
+  // Erase: busy until the flash clears WIP, a second erase is not sent
+  uint32_t const erases = QSPI0.erases();
+  CHECK(flash.writeEnable());
+  CHECK(QSPI0.eraseCommandAsync(QSPI_CMD_ERASE_SECTOR, 0, count_callback, &done));
+  CHECK(!QSPI0.eraseCommandAsync(QSPI_CMD_ERASE_SECTOR, TEST_SECTOR_SIZE, count_callback, &done));
+  QSPI0.task();
+  CHECK(QSPI0.busy());
+  CHECK(done == 1);
+
+  uint8_t status = 0;
+  CHECK(QSPI0.readCommand(QSPI_CMD_READ_STATUS, &status, 1));
+  CHECK(status & 0x01);
+
+  while ( QSPI0.busy() )
+  {
+    host_advance_us(1000);
+    QSPI0.task();
+  }
+  CHECK(done == 2);
+  CHECK(QSPI0.erases() == erases + 1);
+
+  // Write: a blocking flash read completes it first
+  CHECK(flash.writeEnable());
+  CHECK(QSPI0.writeMemoryAsync(0, model, 256, count_callback, &done));
+  CHECK(QSPI0.busy());
+  CHECK(flash.readBuffer(0, buf, 256) == 256);
+  CHECK(!QSPI0.busy());
+  CHECK(done == 3);
+  CHECK(!memcmp(buf, model, 256));
+}
+
+// Erase started through the QSPI0 asynchronous API, blocking reads finish it
+// before reading
+static void test_async_erase(void)
+{
+  Adafruit_QSPI_Flash flash;
+  CHECK(start(&flash, "W25Q16JV_IQ"));
+
+  fill(model, 256);
+  CHECK(flash.writeBuffer(TEST_SECTOR_SIZE, model, 256) == 256);
+  CHECK(flash.readBuffer(TEST_SECTOR_SIZE, buf, 256) == 256);
+
+  uint32_t done = 0;
+  CHECK(flash.writeEnable());
+  CHECK(QSPI0.eraseCommandAsync(QSPI_CMD_ERASE_SECTOR, TEST_SECTOR_SIZE, count_callback, &done));
+  CHECK(QSPI0.busy());
+
+  CHECK(flash.readBuffer(TEST_SECTOR_SIZE, buf, 256) == 256);
+  CHECK(done == 1);
+  CHECK(!QSPI0.busy());
+  CHECK(flash.isErased(TEST_SECTOR_SIZE, 256));
+}
+
+// Addresses beyond 16 MiB with 4-byte addressing, no aliasing of the low 16 MiB
+static void test_addr32(void)
+{
+  Adafruit_QSPI_Flash flash;
+  CHECK(start(&flash, "W25Q256JV_IQ"));
+
+  uint32_t const addrs[] = { 0, 0xfffff0, 0x1000000, 0x1800123, 0x1fffe00 };
+  uint32_t const size = flash.getFlashDevice()->total_size;
+
+  CHECK(flash.eraseRange(0, TEST_SECTOR_SIZE));
+
+  for ( size_t i = 0; i < sizeof(addrs)/sizeof(addrs[0]); i++ )
+  {
+    uint32_t const addr = addrs[i];
+    uint32_t const len = (size - addr < 300) ? size - addr : 300;
+    uint32_t const first = addr & ~(TEST_SECTOR_SIZE - 1UL);
+    uint32_t const last = (addr + len + TEST_SECTOR_SIZE - 1) & ~(TEST_SECTOR_SIZE - 1UL);
+
+    fill(model, len);
+    CHECK(flash.eraseRange(first, last - first));
+    CHECK(flash.writeBuffer(addr, model, len) == len);
+    CHECK(flash.readBuffer(addr, buf, len) == len);
+    CHECK(!memcmp(buf, model, len));
+  }
+
+  // 0 and 16 MiB were written with different data
+  CHECK(flash.readBuffer(0, model, 300) == 300);
+  CHECK(flash.readBuffer(0x1000000, buf, 300) == 300);
+  CHECK(memcmp(buf, model, 300));
+}
+
+// Continuous read mode left behind by a microcontroller only reset, with
+// 3-byte and 4-byte addresses. An 8 clock reset does not reach the mode bits
+// of a 4-byte address read.
+static void test_continuous_read_reset(void)
+{
+  static const char* const names[] = { "W25Q64JV_IQ", "W25Q256JV_IQ" };
+
+  for ( size_t i = 0; i < sizeof(names)/sizeof(names[0]); i++ )
+  {
+    Adafruit_QSPI_Flash flash;
+    CHECK(start(&flash, names[i]));
+    bool const addr32 = flash.getFlashDevice()->total_size > (1UL << 24);
+
+    fill(model, 64);
+    CHECK(flash.eraseSector(0));
+    CHECK(flash.writeBuffer(0, model, 64) == 64);
+    CHECK(flash.readBuffer(0, buf, 64) == 64);
+
+    // Port reset, the flash stays in continuous read mode
+    Adafruit_QSPI_Flash after_reset;
+    CHECK(after_reset.begin());
+    CHECK(after_reset.readBuffer(0, buf, 64) == 64);
+    CHECK(!memcmp(buf, model, 64));
+
+    QSPI0.begin();
+    uint32_t const violations = QSPI0.violations();
+    QSPI0.runCommand(QSPI_CMD_CONTINUOUS_READ_RESET);
+    uint32_t const short_reset = QSPI0.violations() - violations;
+    CHECK(short_reset == (addr32 ? 1U : 0U));
+    expected_violations += short_reset;
+
+    Adafruit_QSPI_Flash after_short_reset;
+    CHECK(after_short_reset.begin());
+    CHECK(after_short_reset.readBuffer(0, buf, 64) == 64);
+    CHECK(!memcmp(buf, model, 64));
+  }
+}
+
+// Memory mapped view follows programs and erases
+static void test_map(void)
+{
+  Adafruit_QSPI_Flash flash;
+  CHECK(start(&flash, "W25Q64JV_IQ"));
+  CHECK(flash.eraseSector(0));
+
+  uint8_t const* map = flash.mapMemory(0, TEST_SECTOR_SIZE);
+  CHECK(map != NULL);
+  if ( !map ) return;
+
+  fill(model, 16);
+  CHECK(flash.writeBuffer(0, model, 16) == 16);
+  CHECK(!memcmp(map, model, 16));
+
+  CHECK(flash.eraseSector(0));
+  CHECK(map[0] == 0xff);
+
+  flash.unmapMemory();
+}
+
+// Devices missing from the table are described from their SFDP table
+static void test_sfdp(void)
+{
+  size_t const count = sizeof(host_devices)/sizeof(host_devices[0]);
+
+  for ( size_t i = 0; i < count; i++ )
+  {
+    // Not in the table under another capacity code
+    static external_flash_device dev;
+    dev = host_devices[i].dev;
+    dev.capacity ^= 0x80;
+
+    // Memory is always read with 4 data lines
+    if ( !dev.supports_qspi ) continue;
+
+    QSPI0.end();
+    QSPI0.setFlashDevice(&dev);
+
+    Adafruit_QSPI_Flash flash;
+    CHECK(flash.begin());
+    if ( !flash.getFlashDevice() ) continue;
+
+    CHECK(flash.getFlashDevice()->total_size == dev.total_size);
+
+    uint32_t const addr = dev.total_size - TEST_SECTOR_SIZE - 100;
+    fill(model, 512);
+    CHECK(flash.eraseRange(addr & ~(TEST_SECTOR_SIZE - 1UL), 2*TEST_SECTOR_SIZE));
+    CHECK(flash.writeBuffer(addr, model, 512) == 512);
+    CHECK(flash.readBuffer(addr, buf, 512) == 512);
+    CHECK(!memcmp(buf, model, 512));
+  }
+}
+
+// end() then begin(dev, true) skips detection and keeps data and modes
+static void test_warm_start(void)
+{
+  static const char* const names[] = { "GD25Q16C", "W25Q16JV_IQ", "W25Q256JV_IQ", "MX25R6435F", "S25FL116K" };
+  size_t const count = sizeof(names)/sizeof(names[0]);
+
+  for ( size_t i = 0; i < count; i++ )
+  {
+    Adafruit_QSPI_Flash flash;
+    CHECK(start(&flash, names[i]));
+
+    external_flash_device const* dev = host_find_device(names[i]);
+    uint32_t const addr = dev->total_size - 2*TEST_SECTOR_SIZE + 77;
+
+    fill(model, 600);
+    CHECK(flash.eraseRange(addr & ~(TEST_SECTOR_SIZE - 1UL), 2*TEST_SECTOR_SIZE));
+    CHECK(flash.writeBuffer(addr, model, 600) == 600);
+
+    // Program still pending at end()
+    CHECK(flash.end());
+    CHECK(flash.getFlashDevice() == NULL);
+    CHECK(flash.readBuffer(addr, buf, 16) == 0);
+
+    host_advance_us(5000);
+    CHECK(flash.begin(NULL, true));
+    CHECK(same_jedec_id(flash.getFlashDevice(), dev));
+    CHECK(flash.readBuffer(addr, buf, 600) == 600);
+    CHECK(!memcmp(buf, model, 600));
+
+    // Another device falls back to a cold begin
+    external_flash_device const* other = host_find_device(names[(i + 1) % count]);
+    CHECK(flash.end());
+    CHECK(flash.begin(other, true));
+    CHECK(flash.getFlashDevice() != other);
+
+    // MCU reset without end() while a program is pending
+    CHECK(flash.writeBuffer(addr + 1000, model, 100) == 100);
+    Adafruit_QSPI_Flash after_reset;
+    CHECK(after_reset.begin(dev, true));
+    CHECK(after_reset.readBuffer(addr + 1000, buf, 100) == 100);
+    CHECK(!memcmp(buf, model, 100));
+    CHECK(after_reset.end());
+  }
+}
+
+// Compile-time device variant: all members are instantiated so that template
+// errors show up in the host build, then used on a 3-byte and a 4-byte
+// address device
+QSPI_FLASH_DEVICE_TYPE(TestFlash, W25Q16JV_IQ);
+QSPI_FLASH_DEVICE_TYPE(TestBigFlash, W25Q256JV_IQ);
+
+template class Adafruit_QSPI_FlashT<TestFlash>;
+template class Adafruit_QSPI_FlashT<TestBigFlash>;
+
+template <class Device>
+static void flasht(void)
+{
+  static const external_flash_device dev = Device::value();
+
+  QSPI0.end();
+  QSPI0.setFlashDevice(&dev);
+
+  Adafruit_QSPI_FlashT<Device> flash;
+  CHECK(flash.begin());
+
+  uint32_t const addr = flash.size() - 2*TEST_SECTOR_SIZE + 100;
+  fill(model, 700);
+
+  CHECK(flash.eraseSector(addr / TEST_SECTOR_SIZE));
+  CHECK(flash.eraseSector(addr / TEST_SECTOR_SIZE + 1));
+  CHECK(flash.writeBuffer(addr, model, 700) == 700);
+  CHECK(flash.readBuffer(addr, buf, 700) == 700);
+  CHECK(!memcmp(buf, model, 700));
+  CHECK(flash.read8(addr) == model[0]);
+
+  CHECK(flash.eraseBlock32((addr - TEST_SECTOR_SIZE) / (32*1024UL)));
+  CHECK(flash.waitUntilReady());
+  CHECK(flash.read32(addr) == 0xffffffff);
+
+  // Microcontroller only reset during an erase
+  CHECK(flash.writeBuffer(addr, model, 700) == 700);
+  CHECK(flash.eraseSector(addr / TEST_SECTOR_SIZE));
+
+  Adafruit_QSPI_FlashT<Device> after_reset;
+  CHECK(after_reset.begin());
+  CHECK(after_reset.read32(addr) == 0xffffffff);
+}
+
+static void test_flasht(void)
+{
+  flasht<TestFlash>();
+  flasht<TestBigFlash>();
+}
+
+#if ADAFRUIT_QSPI_STATS
+// Counters of a known workload, "make test" runs it in a separate
+// -DADAFRUIT_QSPI_STATS=1 build
+static void test_stats(void)
+{
+  Adafruit_QSPI_Flash flash;
+  CHECK(start(&flash, "W25Q64JV_IQ"));
+  CHECK(flash.sync());
+
+  qspi_stats_reset();
+
+  fill(model, 512);
+  CHECK(flash.eraseSector(1));
+  CHECK(flash.writeBuffer(TEST_SECTOR_SIZE, model, 512) == 512);
+  CHECK(flash.readBuffer(TEST_SECTOR_SIZE, buf, 512) == 512);
+
+  // Read outside of the block being erased suspends the erase
+  CHECK(flash.eraseBlock(1));
+  host_advance_us(2000);
+  CHECK(flash.readBuffer(TEST_SECTOR_SIZE, buf, 512) == 512);
+  CHECK(!memcmp(buf, model, 512));
+  CHECK(flash.sync());
+
+  qspi_stats_t const* stats = qspi_stats();
+
+  CHECK(stats->count[QSPI_STATS_ERASE] == 2);
+  CHECK(stats->bytes[QSPI_STATS_ERASE] == TEST_SECTOR_SIZE + 64*1024UL);
+  CHECK(stats->count[QSPI_STATS_PROGRAM] == 2);
+  CHECK(stats->bytes[QSPI_STATS_PROGRAM] == 512);
+  CHECK(stats->count[QSPI_STATS_READ] == 2);
+  CHECK(stats->bytes[QSPI_STATS_READ] == 1024);
+
+  // Simulated program/erase completes in its typical time: a single poll per
+  // wait (before each page and the read, sync()), plus the two of the suspend
+  CHECK(stats->count[QSPI_STATS_WAIT] == 4);
+  CHECK(stats->events[QSPI_STATS_STATUS_POLL] == 6);
+  CHECK(stats->events[QSPI_STATS_ERASE_SUSPEND] == 1);
+}
+#endif
+
+#if ADAFRUIT_QSPI_TRACE
+static void trace_write(uint8_t const* data, uint32_t len, void* arg)
+{
+  fwrite(data, 1, len, (FILE*) arg);
+}
+
+// Capture of a short workload from begin(), "make test" replays it with
+// qspi_replay in a separate -DADAFRUIT_QSPI_TRACE=1 build
+static void test_trace(void)
+{
+  const char* path = getenv("QSPI_TEST_TRACE");
+  if ( !path ) path = "qspi_trace.bin";
+
+  QSPI0.end();
+  QSPI0.setFlashDevice(host_find_device("W25Q16JV_IQ"));
+  qspi_trace_reset();
+
+  Adafruit_QSPI_Flash flash;
+  CHECK(flash.begin());
+
+  fill(model, 1024);
+  CHECK(flash.eraseSector(1));
+  CHECK(flash.writeBuffer(TEST_SECTOR_SIZE, model, 1024) == 1024);
+  CHECK(flash.readBuffer(TEST_SECTOR_SIZE, buf, 1024) == 1024);
+  CHECK(flash.eraseBlock(1));
+  host_advance_us(2000);
+  CHECK(flash.readBuffer(TEST_SECTOR_SIZE, buf, 1024) == 1024);
+  CHECK(!memcmp(buf, model, 1024));
+  CHECK(flash.sync());
+
+  // The replay needs the begin() setup
+  CHECK(qspi_trace_count() < ADAFRUIT_QSPI_TRACE_DEPTH);
+
+  FILE* fp = fopen(path, "wb");
+  CHECK(fp);
+  if ( !fp ) return;
+
+  CHECK(qspi_trace_dump(trace_write, fp) == qspi_trace_count());
+  CHECK(!fclose(fp));
+}
+#endif
+
+static const test_case_t test_cases[] =
+{
+  { "port_page_wrap"  , test_port_page_wrap  },
+  { "random"          , test_random          },
+  { "cache_512"       , test_cache_512       },
+  { "cache_4096"      , test_cache_4096      },
+  { "update"          , test_update          },
+  { "write_back"      , test_write_back      },
+  { "write_back_diff" , test_write_back_diff },
+  { "append"          , test_append          },
+  { "erase_range"     , test_erase_range     },
+  { "scans"           , test_scans           },
+  { "erase_suspend"   , test_erase_suspend   },
+  { "addr32"          , test_addr32          },
+  { "crm_reset"       , test_continuous_read_reset },
+  { "read_int"        , test_read_int        },
+  { "async"           , test_async           },
+  { "async_erase"     , test_async_erase     },
+  { "map"             , test_map             },
+  { "sfdp"            , test_sfdp            },
+  { "warm_start"      , test_warm_start      },
+  { "flasht"          , test_flasht          },
+#if ADAFRUIT_QSPI_STATS
+  { "stats"           , test_stats           },
+#endif
+#if ADAFRUIT_QSPI_TRACE
+  { "trace"           , test_trace           },
+#endif
+};
+
+int main(int argc, char** argv)
+{
+  const char* only = (argc > 1) ? argv[1] : NULL;
+  uint32_t failed_cases = 0;
+
+  for ( size_t i = 0; i < sizeof(test_cases)/sizeof(test_cases[0]); i++ )
+  {
+    if ( only && strcmp(only, test_cases[i].name) ) continue;
+
+    failures = 0;
+    expected_violations = 0;
+    rand_state = 1;
+    uint32_t const violations = QSPI0.violations();
+
+    test_cases[i].run();
+
+    uint32_t const new_violations = QSPI0.violations() - violations - expected_violations;
+    bool const ok = !failures && !new_violations;
+    if ( !ok ) failed_cases++;
+
+    printf("%-16s %s", test_cases[i].name, ok ? "ok" : "FAIL");
+    if ( failures ) printf(", %u failed checks", failures);
+    if ( new_violations ) printf(", %u violations", new_violations);
+    printf("\n");
+  }
+
+  printf("%u failed\n", failed_cases);
+
+  return failed_cases ? 1 : 0;
+}
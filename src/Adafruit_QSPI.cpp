@@ -0,0 +1,114 @@
+/**
+ * @file Adafruit_QSPI.cpp
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach and Dean Miller for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "Adafruit_QSPI.h"
+#include "Adafruit_QSPI_Stats.h"
+
+Adafruit_QSPI::Adafruit_QSPI(void)
+{
+  _async_state = ASYNC_IDLE;
+  _async_wait_wip = false;
+  _async_cb = NULL;
+  _async_arg = NULL;
+}
+
+void Adafruit_QSPI::_async_begin(bool wait_wip, qspi_callback_t cb, void* arg)
+{
+  _async_wait_wip = wait_wip;
+  _async_cb = cb;
+  _async_arg = arg;
+
+  _async_state = ASYNC_XFER;
+}
+
+/**
+ * Default asynchronous read for ports without a background transfer: data is
+ * read right away and the callback is deferred to task().
+ */
+bool Adafruit_QSPI::readMemoryAsync(uint32_t addr, uint8_t *buffer, uint32_t len, qspi_callback_t cb, void* arg)
+{
+  if ( busy() || !readMemory(addr, buffer, len) ) return false;
+
+  _async_begin(false, cb, arg);
+  return true;
+}
+
+/**
+ * Default asynchronous write: data is sent right away, task() then polls the
+ * status register until the page program completes.
+ */
+bool Adafruit_QSPI::writeMemoryAsync(uint32_t addr, uint8_t *data, uint32_t len, qspi_callback_t cb, void* arg)
+{
+  if ( busy() || !writeMemory(addr, data, len) ) return false;
+
+  _async_begin(true, cb, arg);
+  return true;
+}
+
+/**
+ * Default asynchronous erase: command is sent right away, task() then polls
+ * the status register until the erase completes.
+ */
+bool Adafruit_QSPI::eraseCommandAsync(uint8_t command, uint32_t address, qspi_callback_t cb, void* arg)
+{
+  if ( busy() || !eraseCommand(command, address) ) return false;
+
+  _async_begin(true, cb, arg);
+  return true;
+}
+
+void Adafruit_QSPI::task(void)
+{
+  bool result = true;
+
+  if ( _async_state == ASYNC_XFER )
+  {
+    if ( !_async_xfer_complete(&result) ) return;
+
+    if ( result && _async_wait_wip ) _async_state = ASYNC_WIP;
+  }
+
+  if ( _async_state == ASYNC_WIP )
+  {
+    uint8_t status;
+    qspi_stats_event(QSPI_STATS_STATUS_POLL);
+    result = readCommand(QSPI_CMD_READ_STATUS, &status, 1);
+
+    // still programming/erasing
+    if ( result && (status & 0x01) ) return;
+  }
+
+  if ( _async_state == ASYNC_IDLE ) return;
+
+  // Clear state first so that the callback can start the next operation
+  qspi_callback_t const cb = _async_cb;
+  void* const arg = _async_arg;
+
+  _async_state = ASYNC_IDLE;
+  _async_cb = NULL;
+
+  if ( cb ) cb(result, arg);
+}
@@ -19,15 +19,28 @@
 
 #include <Arduino.h>
 
+#define ADAFRUIT_QSPI_VERSION   "3.0.0" ///< library version, as in library.properties
+
 /// QSPI command code
 enum
 {
   QSPI_CMD_QUAD_READ         = 0x6B, // 1 line address, 4 line data
+  QSPI_CMD_QUAD_IO_READ      = 0xEB, // 4 line address, mode bits and data
+
+  QSPI_CMD_FAST_READ         = 0x0B, // 4 line instruction, address and data in QPI mode
+
+  QSPI_CMD_CONTINUOUS_READ_RESET = 0xFF, // leave continuous read mode of 0xEB
 
   QSPI_CMD_READ_JEDEC_ID     = 0x9f,
+  QSPI_CMD_READ_SFDP         = 0x5A, // 3-byte address and 8 dummy cycles in any address mode
 
   QSPI_CMD_PAGE_PROGRAM      = 0x02,
   QSPI_CMD_QUAD_PAGE_PROGRAM = 0x32, // 1 line address, 4 line data
+  QSPI_CMD_QUAD_IO_PAGE_PROGRAM = 0x38, // 4 line address and data (Macronix)
+
+  QSPI_CMD_ENABLE_QPI        = 0x38, // Winbond, GigaDevice
+  QSPI_CMD_EXIT_QPI          = 0xFF,
+  QSPI_CMD_SET_READ_PARAMS   = 0xC0, // dummy cycles of QPI reads
 
   QSPI_CMD_READ_STATUS       = 0x05,
   QSPI_CMD_READ_STATUS2      = 0x35,
@@ -43,13 +56,34 @@ enum
 
   QSPI_CMD_ERASE_SECTOR      = 0x20,
   QSPI_CMD_ERASE_BLOCK       = 0xD8,
+  QSPI_CMD_ERASE_BLOCK32     = 0x52,
   QSPI_CMD_ERASE_CHIP        = 0xC7,
+
+  QSPI_CMD_ENABLE_4B_ADDR    = 0xB7, // address of all memory commands takes 4 bytes
+  QSPI_CMD_EXIT_4B_ADDR      = 0xE9,
+
+  QSPI_CMD_ERASE_SUSPEND     = 0x75,
+  QSPI_CMD_ERASE_RESUME      = 0x7A,
+};
+
+/// Lines used by instruction, address and data of memory read/write
+enum
+{
+  QSPI_XFER_1_1_4 = 0, ///< read 0x6B with 8 dummy cycles, page program 0x32 (default)
+  QSPI_XFER_1_4_4,     ///< read 0xEB with mode bits, page program 0x38
+  QSPI_XFER_4_4_4,     ///< QPI: read 0x0B, page program 0x02
 };
 
+/// Completion callback of asynchronous operations
+/// @param result  true if success
+/// @param arg     user argument given when the operation was started
+typedef void (*qspi_callback_t)(bool result, void* arg);
+
 /// Abstract class provide common APIs for all mcu ports (e.g samd51, nrf52 etc ..)
 class Adafruit_QSPI
 {
   public:
+    Adafruit_QSPI(void);
 
     /**
      * Enable and configure QSPI peripheral clock and pins
@@ -115,12 +149,179 @@ class Adafruit_QSPI
     /// @param len        number of byte to read
     /// @return true if success
     virtual bool writeMemory(uint32_t addr, uint8_t *data, uint32_t len) = 0;
+
+    /// Read the Serial Flash Discoverable Parameters (JESD216) of the flash,
+    /// only valid outside of QPI mode
+    /// @param addr       address in the SFDP space
+    /// @param data       buffer to hold data
+    /// @param len        number of bytes to read
+    /// @return true if supported by the port
+    virtual bool readSFDP(uint32_t addr, uint8_t* data, uint32_t len)
+    {
+      (void) addr; (void) data; (void) len;
+      return false;
+    }
+
+    /// Put the peripheral in memory-mapped read mode so that external flash can be
+    /// read in place (e.g fonts, lookup tables) without copying it to SRAM. The
+    /// port leaves the mode for any other command and re-enters it afterwards,
+    /// but contents read while the flash is programming/erasing are undefined.
+    /// @param addr       flash address of the region
+    /// @param len        size of the region
+    /// @return pointer to addr in the mapped window, or NULL if not supported
+    virtual uint8_t const* mapMemory(uint32_t addr, uint32_t len)
+    {
+      (void) addr; (void) len;
+      return NULL;
+    }
+
+    /// Leave memory-mapped read mode, pointers returned by mapMemory() become invalid
+    virtual void unmapMemory(void) {}
+
+    /// Keep the flash in continuous read mode between QSPI_XFER_1_4_4 reads:
+    /// after the first read the flash expects only address, mode bits and
+    /// dummy clocks, saving the 8 opcode clocks of every following read. The
+    /// port resets the mode on its own before issuing any other command.
+    /// @param mode_bits  mode byte that keeps the flash in continuous read mode
+    ///                   (see external_flash_device), 0 to disable
+    /// @return true if supported by the port
+    virtual bool setContinuousReadMode(uint8_t mode_bits)
+    {
+      return mode_bits == 0;
+    }
+
+    /// Select the memory read instruction. Only changes the peripheral,
+    /// checking that the flash supports the mode is up to the caller.
+    /// @param xfer_mode     QSPI_XFER_1_1_4, QSPI_XFER_1_4_4 or QSPI_XFER_4_4_4
+    /// @param dummy_cycles  dummy clocks, after the mode bits for QSPI_XFER_1_4_4
+    /// @return true if supported by the port
+    virtual bool setReadMode(uint8_t xfer_mode, uint8_t dummy_cycles)
+    {
+      (void) dummy_cycles;
+      return xfer_mode == QSPI_XFER_1_1_4;
+    }
+
+    /// Select the page program instruction
+    /// @param xfer_mode  QSPI_XFER_1_1_4, QSPI_XFER_1_4_4 or QSPI_XFER_4_4_4
+    /// @return true if supported by the port
+    virtual bool setWriteMode(uint8_t xfer_mode)
+    {
+      return xfer_mode == QSPI_XFER_1_1_4;
+    }
+
+    /// Send every instruction on 4 lines. The flash must be switched by the
+    /// caller: enable command sent before enabling, exit command sent before
+    /// disabling. Disabling also restores QSPI_XFER_1_1_4 read/write.
+    /// @param enable  true to enter QPI mode
+    /// @return true if supported by the port
+    virtual bool setQPI(bool enable)
+    {
+      return !enable;
+    }
+
+    /// Number of address bits sent by memory read/write and erase. The flash
+    /// must be switched by the caller e.g with Enable 4-Byte Address Mode 0xB7.
+    /// @param bits  24 or 32
+    /// @return true if supported by the port
+    virtual bool setAddressLength(uint8_t bits)
+    {
+      return bits == 24;
+    }
+
+    /// @return true if the peripheral can wait for the flash to be ready on its own
+    virtual bool hasReadyWait(void) { return false; }
+
+    /// Wait for the flash to complete a program/erase: the peripheral polls the
+    /// Write-In-Progress bit while the CPU yields. Only if hasReadyWait().
+    /// @param timeout_us  give up after this many microseconds
+    /// @return true if ready, false on timeout
+    virtual bool waitReady(uint32_t timeout_us)
+    {
+      (void) timeout_us;
+      return false;
+    }
+
+    //------------- Asynchronous API -------------//
+    // Only one asynchronous operation can be in flight. Its callback is always
+    // invoked from task(), never from interrupt context or from inside the
+    // *Async() call itself. Blocking calls made while busy() wait for the bus
+    // transfer to finish, but not for the flash to complete a program/erase.
+    // Adafruit_QSPI_Flash calls complete the operation first, invoking its
+    // callback.
+
+    /// Start reading external flash contents without waiting for the transfer.
+    /// buffer must stay valid until the callback is invoked.
+    /// @param addr       address to read
+    /// @param buffer     buffer to hold data
+    /// @param len        number of byte to read
+    /// @param cb         invoked from task() when data is in buffer, can be NULL
+    /// @param arg        passed to cb
+    /// @return true if the operation is started
+    virtual bool readMemoryAsync(uint32_t addr, uint8_t *buffer, uint32_t len, qspi_callback_t cb, void* arg);
+
+    /// Start writing external flash contents without waiting for the page
+    /// program to complete. Write Enable must be issued first, as for writeMemory().
+    /// @param addr       address to write
+    /// @param data       writing data, must stay valid until the callback is invoked
+    /// @param len        number of byte to write
+    /// @param cb         invoked from task() once the flash is no longer busy, can be NULL
+    /// @param arg        passed to cb
+    /// @return true if the operation is started
+    virtual bool writeMemoryAsync(uint32_t addr, uint8_t *data, uint32_t len, qspi_callback_t cb, void* arg);
+
+    /// Start an erase without waiting for the flash to complete it.
+    /// Write Enable must be issued first, as for eraseCommand().
+    /// @param command  can be sector erase (0x20) or block erase 0xD8
+    /// @param address  adddress to be erased
+    /// @param cb       invoked from task() once the flash is no longer busy, can be NULL
+    /// @param arg      passed to cb
+    /// @return true if the operation is started
+    virtual bool eraseCommandAsync(uint8_t command, uint32_t address, qspi_callback_t cb, void* arg);
+
+    /// @return true while an asynchronous operation is in flight
+    bool busy(void) { return _async_state != ASYNC_IDLE; }
+
+    /// Advance the asynchronous operation in flight and invoke its callback
+    /// once complete. Should be called regularly e.g from loop().
+    void task(void);
+
+  protected:
+    enum
+    {
+      ASYNC_IDLE = 0,
+      ASYNC_XFER,   ///< command or data transfer still in progress on the bus
+      ASYNC_WIP,    ///< waiting for the flash to clear its Write-In-Progress bit
+    };
+
+    volatile uint8_t _async_state;
+    bool             _async_wait_wip;
+    qspi_callback_t  _async_cb;
+    void*            _async_arg;
+
+    /// Record the asynchronous operation a port has just started
+    /// @param wait_wip  true for program/erase, which also wait for the flash to be ready
+    /// @param cb        completion callback
+    /// @param arg       passed to cb
+    void _async_begin(bool wait_wip, qspi_callback_t cb, void* arg);
+
+    /// Whether the bus transfer of the asynchronous operation has finished.
+    /// Ports with interrupt or DMA driven transfers override this, the
+    /// default is for ports that complete the transfer before returning.
+    /// @param result  set to the transfer result once finished
+    /// @return true if finished
+    virtual bool _async_xfer_complete(bool* result)
+    {
+      *result = true;
+      return true;
+    }
 };
 
 #if defined __SAMD51__
   #include "ports/Adafruit_QSPI_SAMD.h"
 #elif defined NRF52840_XXAA
   #include "ports/Adafruit_QSPI_NRF.h"
+#elif defined __linux__
+  #include "ports/Adafruit_QSPI_Host.h"
 #else
   #error "MCU is not supported"
 #endif
@@ -0,0 +1,42 @@
+/**
+ * @file Adafruit_QSPI_CRC32.h
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ADAFRUIT_QSPI_CRC32_H_
+#define ADAFRUIT_QSPI_CRC32_H_
+
+#include <stdint.h>
+
+/**
+ * CRC-32 (IEEE 802.3, same as zlib/PNG) with a slice-by-4 table, i.e one
+ * table lookup per byte but four bytes folded per step.
+ * @param crc   CRC of the preceding data, 0 to start
+ * @param data  data
+ * @param len   number of bytes
+ * @return CRC of the preceding data followed by data
+ */
+uint32_t qspi_crc32(uint32_t crc, uint8_t const* data, uint32_t len);
+
+#endif /* ADAFRUIT_QSPI_CRC32_H_ */
@@ -0,0 +1,249 @@
+/**
+ * @file Adafruit_QSPI_Cache.cpp
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "Adafruit_QSPI_Cache.h"
+
+Adafruit_QSPI_Cache::Adafruit_QSPI_Cache(void)
+{
+  _data = NULL;
+  _tags = NULL;
+  _ref = NULL;
+  _dirty = NULL;
+  _dirty_ms = NULL;
+
+  _line_count = 0;
+  _line_size = 0;
+  _hand = 0;
+
+  _hits = _misses = 0;
+}
+
+Adafruit_QSPI_Cache::~Adafruit_QSPI_Cache()
+{
+  end();
+}
+
+bool Adafruit_QSPI_Cache::begin(uint16_t line_count, uint32_t line_size)
+{
+  end();
+
+  if ( !line_count || !line_size || (line_size & (line_size - 1)) ) return false;
+
+  _data = (uint8_t*) malloc(line_count*line_size);
+  _tags = (uint32_t*) malloc(line_count*sizeof(uint32_t));
+  _ref  = (uint8_t*) malloc(line_count);
+  _dirty = (uint8_t*) malloc(line_count);
+  _dirty_ms = (uint32_t*) malloc(line_count*sizeof(uint32_t));
+
+  if ( !_data || !_tags || !_ref || !_dirty || !_dirty_ms )
+  {
+    end();
+    return false;
+  }
+
+  _line_count = line_count;
+  _line_size = line_size;
+
+  // Fresh allocations, invalidate() would read uninitialized tags
+  for(uint16_t i=0; i<line_count; i++) _tags[i] = INVALID_ADDR;
+  memset(_ref, 0, line_count);
+  memset(_dirty, 0, line_count);
+  memset(_dirty_ms, 0, line_count*sizeof(uint32_t));
+  _hand = 0;
+
+  resetStats();
+
+  return true;
+}
+
+void Adafruit_QSPI_Cache::end(void)
+{
+  free(_data);
+  free(_tags);
+  free(_ref);
+  free(_dirty);
+  free(_dirty_ms);
+
+  _data = NULL;
+  _tags = NULL;
+  _ref = NULL;
+  _dirty = NULL;
+  _dirty_ms = NULL;
+
+  _line_count = 0;
+  _line_size = 0;
+}
+
+void Adafruit_QSPI_Cache::invalidateAll(void)
+{
+  invalidate(0, INVALID_ADDR);
+}
+
+int32_t Adafruit_QSPI_Cache::_find(uint32_t addr)
+{
+  uint32_t const tag = addr & ~(_line_size - 1);
+
+  for(uint16_t i=0; i<_line_count; i++)
+  {
+    if ( _tags[i] == tag ) return i;
+  }
+
+  return -1;
+}
+
+uint8_t* Adafruit_QSPI_Cache::lookup(uint32_t addr)
+{
+  int32_t const i = _find(addr);
+
+  if ( i < 0 )
+  {
+    _misses++;
+    return NULL;
+  }
+
+  _ref[i] = 1;
+  _hits++;
+  return _line(i);
+}
+
+// Clock hand skips recently referenced lines once, clearing their bit, and
+// stops on the next victim
+void Adafruit_QSPI_Cache::_select_victim(void)
+{
+  while ( _tags[_hand] != INVALID_ADDR && _ref[_hand] )
+  {
+    _ref[_hand] = 0;
+    _hand = (_hand + 1) % _line_count;
+  }
+}
+
+bool Adafruit_QSPI_Cache::dirtyVictim(uint32_t* addr, uint8_t const** data)
+{
+  if ( !_line_count ) return false;
+
+  _select_victim();
+  if ( !_dirty[_hand] ) return false;
+
+  *addr = _tags[_hand];
+  *data = _line(_hand);
+  return true;
+}
+
+uint8_t* Adafruit_QSPI_Cache::allocate(uint32_t addr)
+{
+  if ( !_line_count ) return NULL;
+
+  _select_victim();
+
+  uint16_t const i = _hand;
+  _hand = (_hand + 1) % _line_count;
+
+  // Dirty victim not flushed by the owner: its data is lost
+  _dirty[i] = 0;
+
+  _tags[i] = addr & ~(_line_size - 1);
+  _ref[i] = 1;
+
+  return _line(i);
+}
+
+bool Adafruit_QSPI_Cache::oldestDirty(uint32_t* addr, uint8_t const** data, uint32_t* since_ms)
+{
+  uint32_t const now = millis();
+  int32_t oldest = -1;
+
+  for(uint16_t i=0; i<_line_count; i++)
+  {
+    if ( _dirty[i] && (oldest < 0 || now - _dirty_ms[i] > now - _dirty_ms[oldest]) ) oldest = i;
+  }
+
+  if ( oldest < 0 ) return false;
+
+  *addr = _tags[oldest];
+  *data = _line(oldest);
+  *since_ms = _dirty_ms[oldest];
+  return true;
+}
+
+void Adafruit_QSPI_Cache::markDirty(uint32_t addr)
+{
+  int32_t const i = _find(addr);
+  if ( i < 0 || _dirty[i] ) return;
+
+  _dirty[i] = 1;
+  _dirty_ms[i] = millis();
+}
+
+void Adafruit_QSPI_Cache::markClean(uint32_t addr)
+{
+  int32_t const i = _find(addr);
+  if ( i >= 0 ) _dirty[i] = 0;
+}
+
+void Adafruit_QSPI_Cache::program(uint32_t addr, uint8_t const* data, uint32_t len)
+{
+  for(uint16_t i=0; i<_line_count; i++)
+  {
+    uint32_t const tag = _tags[i];
+    if ( tag == INVALID_ADDR || tag >= addr + len || addr >= tag + _line_size ) continue;
+
+    uint32_t const start = max(addr, tag);
+    uint32_t const end   = min(addr + len, tag + _line_size);
+    uint8_t* line = _line(i);
+
+    // Program can only clear bits
+    for(uint32_t a = start; a < end; a++) line[a - tag] &= data[a - addr];
+  }
+}
+
+void Adafruit_QSPI_Cache::erase(uint32_t addr, uint32_t len)
+{
+  for(uint16_t i=0; i<_line_count; i++)
+  {
+    uint32_t const tag = _tags[i];
+    if ( tag == INVALID_ADDR || tag >= addr + len || addr >= tag + _line_size ) continue;
+
+    uint32_t const start = max(addr, tag);
+    uint32_t const end   = min(addr + len, tag + _line_size);
+
+    memset(_line(i) + (start - tag), 0xff, end - start);
+
+    // Flash now holds the same data as the line
+    if ( start == tag && end == tag + _line_size ) _dirty[i] = 0;
+  }
+}
+
+void Adafruit_QSPI_Cache::invalidate(uint32_t addr, uint32_t len)
+{
+  for(uint16_t i=0; i<_line_count; i++)
+  {
+    uint32_t const tag = _tags[i];
+    if ( tag == INVALID_ADDR || _dirty[i] || tag >= addr + len || addr >= tag + _line_size ) continue;
+
+    _tags[i] = INVALID_ADDR;
+    _ref[i] = 0;
+  }
+}
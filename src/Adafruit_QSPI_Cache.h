@@ -0,0 +1,143 @@
+/**
+ * @file Adafruit_QSPI_Cache.h
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ADAFRUIT_QSPI_CACHE_H_
+#define ADAFRUIT_QSPI_CACHE_H_
+
+#include <Arduino.h>
+
+/**************************************************************************/
+/*!
+    @brief  RAM cache of external flash contents, made of a fixed number of
+    lines of power of two size, replaced with the CLOCK (second chance)
+    algorithm. Attached to Adafruit_QSPI_Flash with setCache(), it serves
+    readBuffer() and is kept coherent by writeBuffer() and erase functions:
+    programmed data is ANDed into cached lines and erased ranges read as 0xFF,
+    the same way the flash itself changes.
+
+    Lines can also be dirty i.e newer than the flash, for the write-back mode
+    of Adafruit_QSPI_Flash. Dirty lines are never dropped by the cache itself,
+    the owner flushes them before they are evicted.
+*/
+/**************************************************************************/
+class Adafruit_QSPI_Cache
+{
+  public:
+    Adafruit_QSPI_Cache(void);
+    ~Adafruit_QSPI_Cache();
+
+    /// Allocate the cache
+    /// @param line_count  number of lines
+    /// @param line_size   bytes per line, power of two e.g 512 for FatFs sectors or 4096 for flash sectors
+    /// @return true if success
+    bool begin(uint16_t line_count, uint32_t line_size = 4096);
+
+    /// Free the cache
+    void end(void);
+
+    uint16_t lineCount(void) { return _line_count; } ///< number of lines
+    uint32_t lineSize(void)  { return _line_size; }  ///< bytes per line
+
+    /// Find the line holding addr, counted as hit or miss
+    /// @param addr  flash address
+    /// @return line contents, NULL if not cached
+    uint8_t* lookup(uint32_t addr);
+
+    /// Evict a line and assign it to the line holding addr, caller must fill it.
+    /// A dirty victim must be flushed and cleaned first, see dirtyVictim().
+    /// @param addr  flash address
+    /// @return line contents to be filled
+    uint8_t* allocate(uint32_t addr);
+
+    /// Check whether the line that allocate() would evict is dirty
+    /// @param addr  set to the flash address of the victim if dirty
+    /// @param data  set to its contents if dirty
+    /// @return true if the victim is dirty
+    bool dirtyVictim(uint32_t* addr, uint8_t const** data);
+
+    /// Find the line that has been dirty for the longest time
+    /// @param addr      set to its flash address
+    /// @param data      set to its contents
+    /// @param since_ms  set to the millis() value when it first became dirty
+    /// @return false if no line is dirty
+    bool oldestDirty(uint32_t* addr, uint8_t const** data, uint32_t* since_ms);
+
+    /// Mark the cached line holding addr as newer than the flash
+    /// @param addr  flash address
+    void markDirty(uint32_t addr);
+
+    /// Mark the cached line holding addr as equal to the flash e.g once flushed
+    /// @param addr  flash address
+    void markClean(uint32_t addr);
+
+    /// Update cached lines with data programmed to flash
+    /// @param addr  flash address
+    /// @param data  programmed data
+    /// @param len   number of bytes
+    void program(uint32_t addr, uint8_t const* data, uint32_t len);
+
+    /// Update cached lines with an erase of flash. Dirty lines that are fully
+    /// erased become clean.
+    /// @param addr  flash address, start of sector/block
+    /// @param len   size of the erased sector/block
+    void erase(uint32_t addr, uint32_t len);
+
+    /// Drop clean cached lines of a range e.g when flash contents are unknown after an error
+    /// @param addr  flash address
+    /// @param len   number of bytes
+    void invalidate(uint32_t addr, uint32_t len);
+
+    /// Drop all clean cached lines
+    void invalidateAll(void);
+
+    uint32_t hits(void)   { return _hits; }   ///< lookups served from the cache
+    uint32_t misses(void) { return _misses; } ///< lookups that had to read the flash
+
+    /// Reset hit/miss counters
+    void resetStats(void) { _hits = _misses = 0; }
+
+  private:
+    enum { INVALID_ADDR = 0xFFFFFFFFUL };
+
+    uint8_t*  _data;
+    uint32_t* _tags;  // line address of each line, INVALID_ADDR if empty
+    uint8_t*  _ref;   // referenced since the clock hand last passed
+    uint8_t*  _dirty; // newer than the flash
+    uint32_t* _dirty_ms;
+
+    uint16_t _line_count;
+    uint32_t _line_size;
+    uint16_t _hand;
+
+    uint32_t _hits;
+    uint32_t _misses;
+
+    uint8_t* _line(uint16_t i) { return _data + i*_line_size; }
+    int32_t  _find(uint32_t addr);
+    void     _select_victim(void);
+};
+
+#endif /* ADAFRUIT_QSPI_CACHE_H_ */
@@ -44,6 +44,9 @@
  */
 
 #include "Adafruit_QSPI_Flash.h"
+#include "Adafruit_QSPI_CRC32.h"
+#include "Adafruit_QSPI_SFDP.h"
+#include "Adafruit_QSPI_Stats.h"
 
 /// List of all possible flash devices used by Adafruit boards
 static const external_flash_device possible_devices[] =
@@ -51,6 +54,7 @@ static const external_flash_device possible_devices[] =
   GD25Q16C, GD25Q64C,    // Main devices current Adafruit
   S25FL116K, S25FL216K,
   W25Q16FW, W25Q64JV_IQ, // Only a handful of production run
+  W25Q256JV_IQ,          // 32MiB, needs 4-byte addresses
 
   MX25R6435F,            // Nordic PCA10056
 };
@@ -61,39 +65,192 @@ enum
   EXTERNAL_FLASH_DEVICE_COUNT = sizeof(possible_devices)/sizeof(possible_devices[0])
 };
 
+/// Device not in the list, described by its SFDP table. Kept so that a later
+/// begin() with the same chip skips the parse.
+static external_flash_device sfdp_device;
+static bool sfdp_device_valid = false;
+
+static bool same_jedec_id(external_flash_device const* dev, uint8_t const ids[3])
+{
+  return ids[0] == dev->manufacturer_id && ids[1] == dev->memory_type && ids[2] == dev->capacity;
+}
+
+/// Completion polling
+enum
+{
+  QSPI_FLASH_WRITE_STATUS_US = 15000, ///< typical status register write, not in the device table
+  QSPI_FLASH_POLL_MIN_US     = 8,     ///< first interval between status polls
+  QSPI_FLASH_TIMEOUT_FACTOR  = 16,    ///< timeout as a multiple of the typical time
+  QSPI_FLASH_TIMEOUT_MIN_US  = 50000, ///< timeout of short or unknown operations
+  QSPI_FLASH_TASK_MAX_US     = 1000,  ///< longest interval between task() calls
+  QSPI_FLASH_RESUME_MIN_US   = 1000,  ///< erase runs at least this long between suspends
+};
+
+/// Read size of isErased(), verify() and crc32(), on the stack
+enum
+{
+  QSPI_FLASH_SCAN_CHUNK = 512,
+};
+
+/// Bit differences between current flash contents and data, compared a word at a time
+enum
+{
+  BITS_TO_CLEAR = 0x01, ///< program would change flash
+  BITS_TO_SET   = 0x02, ///< only an erase can reach data
+};
+
+static uint8_t compare_bits(uint8_t const* current, uint8_t const* data, uint32_t len)
+{
+  uint32_t to_clear = 0, to_set = 0;
+
+  while ( len >= 4 )
+  {
+    uint32_t cur, dat;
+    memcpy(&cur, current, 4);
+    memcpy(&dat, data, 4);
+
+    to_clear |= cur & ~dat;
+    to_set   |= dat & ~cur;
+
+    current += 4; data += 4; len -= 4;
+  }
+
+  while ( len-- )
+  {
+    to_clear |= (uint8_t) (*current & ~*data);
+    to_set   |= (uint8_t) (*data & ~*current);
+
+    current++; data++;
+  }
+
+  return (to_clear ? BITS_TO_CLEAR : 0) | (to_set ? BITS_TO_SET : 0);
+}
+
+/// Programming all 0xFF does not change flash
+static bool is_erased(uint8_t const* data, uint32_t len)
+{
+  uint32_t bits = 0xffffffff;
+
+  while ( len >= 4 )
+  {
+    uint32_t dat;
+    memcpy(&dat, data, 4);
+    bits &= dat;
+
+    data += 4; len -= 4;
+  }
+
+  while ( len-- ) bits &= 0xffffff00UL | *data++;
+
+  return bits == 0xffffffff;
+}
+
 
 /// Constructor
 Adafruit_QSPI_Flash::Adafruit_QSPI_Flash(void) : Adafruit_SPIFlash(0)
 {
   _flash_dev = NULL;
+  _end_dev = NULL;
+  _qpi = false;
+  _mapped = false;
+  _cache = NULL;
+  _write_back = false;
+  _write_back_max_ms = 0;
+  _diff_write = false;
+  _append_addr = 0;
+  _append_len = 0;
+
+  // State of the chip is unknown until begin() has polled it
+  _wip = true;
+  _wait_start_us = 0;
+  _wait_typical_us = 0;
+
+  _erase_addr = _erase_size = 0;
+  _erase_suspended = false;
+  _suspend_start_us = _resume_us = 0;
 }
 
 /**************************************************************************/
 /*! 
     @brief Initialize QSPI peripheral and external flash device. It will
     also detect all known flash devices on the board and enable quad mode if
-    found. QSPI is also set to max possible speed with device.
+    found. QSPI is also set to max possible speed with device. Devices not in
+    the list are described from their SFDP table.
 
     @returns true if success
 */
 /**************************************************************************/
-bool Adafruit_QSPI_Flash::begin(void){
+bool Adafruit_QSPI_Flash::begin(void)
+{
+  return begin(NULL);
+}
+
+/**************************************************************************/
+/*! 
+    @brief Same as begin(), using flash_dev instead of the device list and
+    SFDP when its JEDEC ID matches the flash. It can be a table entry for a
+    device with incomplete or wrong SFDP, or a copy of getFlashDevice() saved
+    by the application to skip the SFDP parse on later boots.
+
+    With warm_start, a chip left by end() that is still powered is resumed
+    without the device detection, the reset and the quad enable write: only
+    its JEDEC ID and status are checked. flash_dev can then be NULL to use
+    the device found before end(). Anything unexpected falls back to the full
+    initialization.
+
+    @param flash_dev device description, must stay valid while in use
+    @param warm_start trust flash_dev or the device before end()
+    @returns true if success
+*/
+/**************************************************************************/
+bool Adafruit_QSPI_Flash::begin(external_flash_device const* flash_dev, bool warm_start)
+{
 
 	QSPI0.begin();
 
+	// QPI and continuous read mode survive a microcontroller only reset, flash
+	// would not decode the JEDEC ID command.
+	if ( QSPI0.setQPI(true) )
+	{
+	  QSPI0.runCommand(QSPI_CMD_EXIT_QPI);
+	  QSPI0.setQPI(false);
+	}
+	// Long mode bit reset, 16 clocks: the address length is unknown and with
+	// 4-byte addresses the mode bits follow 8 quad address clocks
+	uint8_t const ff = 0xff;
+	QSPI0.writeCommand(QSPI_CMD_CONTINUOUS_READ_RESET, &ff, 1);
+
+	if ( warm_start && _warm_start(flash_dev ? flash_dev : _end_dev) ) return _configure();
+
+	// Only status is readable while a program/erase from before a reset
+	// completes. All ones is an empty bus, detection fails below.
+	for ( uint8_t status = readStatus(); (status & 0x01) && status != 0xFF; status = readStatus() ) {}
+
 	uint8_t jedec_ids[3];
 	QSPI0.readCommand(QSPI_CMD_READ_JEDEC_ID, jedec_ids, 3);
 
-	for (uint8_t i = 0; i < EXTERNAL_FLASH_DEVICE_COUNT; i++) {
+	_flash_dev = NULL;
+
+	if ( flash_dev && same_jedec_id(flash_dev, jedec_ids) ) _flash_dev = flash_dev;
+
+	for (uint8_t i = 0; i < EXTERNAL_FLASH_DEVICE_COUNT && !_flash_dev; i++) {
 	  const external_flash_device* possible_device = &possible_devices[i];
-	  if (jedec_ids[0] == possible_device->manufacturer_id &&
-	      jedec_ids[1] == possible_device->memory_type &&
-	      jedec_ids[2] == possible_device->capacity) {
+	  if ( same_jedec_id(possible_device, jedec_ids) ) {
 	    _flash_dev = possible_device;
-	    break;
 	  }
 	}
 
+	// Unknown device: build its description from SFDP once
+	if ( !_flash_dev )
+	{
+	  if ( !(sfdp_device_valid && same_jedec_id(&sfdp_device, jedec_ids)) )
+	  {
+	    sfdp_device_valid = qspi_sfdp_read_device(&sfdp_device, jedec_ids);
+	  }
+
+	  if ( sfdp_device_valid ) _flash_dev = &sfdp_device;
+	}
+
 	if (_flash_dev == NULL) return false;
 
   // We don't know what state the flash is in so wait for any remaining writes and then reset.
@@ -101,7 +258,13 @@ bool Adafruit_QSPI_Flash::begin(void){
   // The write in progress bit should be low.
   while ( readStatus() & 0x01 ) {}
 
-  // The suspended write/erase bit should be low.
+  // The suspended write/erase bit should be low. An erase suspended by a read
+  // before a microcontroller only reset would never complete by itself.
+  if ( _flash_dev->erase_suspend_us && (readStatus2() & 0x80) )
+  {
+    QSPI0.runCommand(QSPI_CMD_ERASE_RESUME);
+    while ( readStatus() & 0x01 ) {}
+  }
   while ( readStatus2() & 0x80 ) {}
 
   QSPI0.runCommand(QSPI_CMD_ENABLE_RESET);
@@ -110,6 +273,9 @@ bool Adafruit_QSPI_Flash::begin(void){
   // Wait 30us for the reset
   delayMicroseconds(30);
 
+  // Poll once before the first access whatever happens next
+  _wip = true;
+
   // Speed up to max device frequency
   QSPI0.setClockSpeed(_flash_dev->max_clock_speed_mhz*1000000UL);
 
@@ -133,6 +299,8 @@ bool Adafruit_QSPI_Flash::begin(void){
         } else {
             QSPI0.writeCommand(QSPI_CMD_WRITE_STATUS, full_status, 2);
         }
+
+        _start_wait(QSPI_FLASH_WRITE_STATUS_US);
     }
   }
 
@@ -148,11 +316,77 @@ bool Adafruit_QSPI_Flash::begin(void){
   // Turn off writes in case this is a microcontroller only reset.
   QSPI0.runCommand(QSPI_CMD_WRITE_DISABLE);
 
-  _wait_for_flash_ready();
+  // Stuck chip: not usable, getFlashDevice() stays NULL
+  if ( !_wait_for_flash_ready() )
+  {
+    _flash_dev = NULL;
+    return false;
+  }
+
+  return _configure();
+}
+
+/**
+ * Resume a chip that end() left idle in single line mode: it must still be
+ * the same device, idle with writes disabled and quad enabled.
+ * @param flash_dev  device found before
+ * @return false if the chip needs the full begin()
+ */
+bool Adafruit_QSPI_Flash::_warm_start(external_flash_device const* flash_dev)
+{
+  if ( !flash_dev ) return false;
+
+  // WIP and WEL low, only status is readable during a program/erase
+  uint8_t const status = readStatus();
+  if ( status & 0x03 ) return false;
+
+  uint8_t jedec_ids[3];
+  if ( !QSPI0.readCommand(QSPI_CMD_READ_JEDEC_ID, jedec_ids, 3) || !same_jedec_id(flash_dev, jedec_ids) ) return false;
+
+  // Suspended and quad enable bits are in the second status byte if any
+  uint8_t const status2 = flash_dev->single_status_byte ? status : readStatus2();
+  if ( !flash_dev->single_status_byte && (status2 & 0x80) ) return false;
+  if ( (status2 & flash_dev->quad_enable_bit_mask) != flash_dev->quad_enable_bit_mask ) return false;
+
+  _flash_dev = flash_dev;
+  _wip = false;
+  _erase_size = 0;
+  _erase_suspended = false;
+
+  QSPI0.setClockSpeed(_flash_dev->max_clock_speed_mhz*1000000UL);
+
+  return true;
+}
+
+/**
+ * Address length and transfer modes of an idle, reset or resumed flash, last
+ * step of begin()
+ * @return true if success, false clears the flash device
+ */
+bool Adafruit_QSPI_Flash::_configure(void)
+{
+  // Memory beyond 16MiB is only reachable with 4-byte addresses. A reset
+  // brings the device back to 3-byte addresses, both sides switch together.
+  addrsize = 24;
+  if ( _flash_dev->total_size > (1UL << 24) )
+  {
+    QSPI0.runCommand(QSPI_CMD_ENABLE_4B_ADDR);
+    if ( !QSPI0.setAddressLength(32) )
+    {
+      QSPI0.runCommand(QSPI_CMD_EXIT_4B_ADDR);
+      _flash_dev = NULL;
+      return false;
+    }
+
+    addrsize = 32;
+  }
+
+  // Use the fastest transfer mode supported by both the device and the port
+  _qpi = false;
+  _set_transfer_modes();
 
   // Adafruit_SPIFlash variables
   currentAddr = 0;
-  addrsize = 24;
   totalsize = _flash_dev->total_size;
   pagesize = QSPI_FLASH_PAGE_SIZE;
   pages = totalsize/QSPI_FLASH_PAGE_SIZE;
@@ -163,15 +397,176 @@ bool Adafruit_QSPI_Flash::begin(void){
 }
 
 /**
- * Disable qspi peripheral clock
- * @return true if success
+ * Wait for the last program/erase to complete. Nothing is sent to an idle chip,
+ * so reads of a flash that is not being written cost a single transaction.
+ * Otherwise the CPU is given away for its
+ * typical time first, as polling earlier only occupies the bus (and on SAMD51
+ * flushes the cache). Status is then polled with an interval that doubles up
+ * to a quarter of the typical time, or by the peripheral itself if it can.
+ * An operation started through the QSPI0 asynchronous API is not tracked by
+ * _wip, it is driven to completion first, invoking its callback.
+ * @return true if ready, false if the flash is still busy after
+ *         QSPI_FLASH_TIMEOUT_FACTOR times the typical time
  */
-bool Adafruit_QSPI_Flash::end(void)
+bool Adafruit_QSPI_Flash::_wait_for_flash_ready(void)
+{
+  if ( QSPI0.busy() && !_wait_async() ) return false;
+  if ( !_wip ) return true;
+
+  uint32_t const start_us = qspi_stats_start();
+  bool const result = _wait_busy();
+  qspi_stats_record(QSPI_STATS_WAIT, 0, start_us);
+
+  return result;
+}
+
+// Run task() of the asynchronous operation until it is complete, the longest
+// one it can be is a block erase
+bool Adafruit_QSPI_Flash::_wait_async(void)
+{
+  uint32_t const typical_us = _flash_dev ? 1000UL*_flash_dev->typical_block_erase_ms : 0;
+  uint32_t const timeout_us = max(typical_us*QSPI_FLASH_TIMEOUT_FACTOR, (uint32_t) QSPI_FLASH_TIMEOUT_MIN_US);
+  uint32_t const start_us = micros();
+  uint32_t interval_us = QSPI_FLASH_POLL_MIN_US;
+
+  QSPI0.task();
+
+  while ( QSPI0.busy() )
+  {
+    if ( (uint32_t) (micros() - start_us) >= timeout_us )
+    {
+      if ( _cache ) _cache->invalidateAll();
+      return false;
+    }
+
+    uint32_t const poll_us = micros();
+    while ( (uint32_t) (micros() - poll_us) < interval_us ) yield();
+
+    interval_us = min(2*interval_us, (uint32_t) QSPI_FLASH_TASK_MAX_US);
+    QSPI0.task();
+  }
+
+  return true;
+}
+
+bool Adafruit_QSPI_Flash::_wait_busy(void)
 {
-  // TODO implement later
+
+  uint32_t const typical_us = _wait_typical_us;
+  uint32_t const start_us = typical_us ? _wait_start_us : micros();
+  uint32_t const timeout_us = max(typical_us*QSPI_FLASH_TIMEOUT_FACTOR, (uint32_t) QSPI_FLASH_TIMEOUT_MIN_US);
+
+  _wait_typical_us = 0;
+
+  // Sleep through the typical time, delay() lets an RTOS run other tasks
+  uint32_t elapsed_us = micros() - start_us;
+  if ( elapsed_us + 1000 < typical_us ) delay((typical_us - elapsed_us)/1000);
+  while ( (uint32_t) (micros() - start_us) < typical_us ) yield();
+
+  if ( QSPI0.hasReadyWait() )
+  {
+    elapsed_us = micros() - start_us;
+    if ( elapsed_us >= timeout_us || !QSPI0.waitReady(timeout_us - elapsed_us) )
+    {
+      if ( _cache ) _cache->invalidateAll();
+      return false;
+    }
+
+    _wip = false;
+    return true;
+  }
+
+  uint32_t const max_interval_us = max(typical_us/4, (uint32_t) QSPI_FLASH_POLL_MIN_US);
+  uint32_t interval_us = QSPI_FLASH_POLL_MIN_US;
+
+  // both WIP and WREN bit should be clear
+  while ( readStatus() & 0x03 )
+  {
+    if ( (uint32_t) (micros() - start_us) >= timeout_us )
+    {
+      // Whatever the flash did with the last program/erase is unknown
+      if ( _cache ) _cache->invalidateAll();
+      return false;
+    }
+
+    uint32_t const poll_us = micros();
+    while ( (uint32_t) (micros() - poll_us) < interval_us ) yield();
+
+    interval_us = min(2*interval_us, max_interval_us);
+  }
+
+  _wip = false;
   return true;
 }
 
+/**
+ * Select the read/write instructions that need the least clocks: QPI (4-4-4),
+ * else quad address (1-4-4) with continuous read mode, else the default 1-1-4.
+ */
+void Adafruit_QSPI_Flash::_set_transfer_modes(void)
+{
+  if ( !_flash_dev->supports_qspi ) return;
+
+  uint8_t const qpi_dummy = _flash_dev->qpi_read_dummy_cycles;
+
+  // Port accepting the 4-4-4 read also accepts QPI
+  if ( qpi_dummy && QSPI0.setReadMode(QSPI_XFER_4_4_4, qpi_dummy) )
+  {
+    QSPI0.runCommand(QSPI_CMD_ENABLE_QPI);
+    QSPI0.setQPI(true);
+    _qpi = true;
+
+    uint8_t const params = ((qpi_dummy/2 - 1) & 0x03) << 4;
+    QSPI0.writeCommand(QSPI_CMD_SET_READ_PARAMS, &params, 1);
+
+    QSPI0.setWriteMode(QSPI_XFER_4_4_4);
+    return;
+  }
+
+  if ( _flash_dev->quad_io_read_dummy_cycles &&
+       QSPI0.setReadMode(QSPI_XFER_1_4_4, _flash_dev->quad_io_read_dummy_cycles) )
+  {
+    // Skip the read opcode of all but the first read
+    if ( _flash_dev->continuous_read_mode_bits )
+    {
+      QSPI0.setContinuousReadMode(_flash_dev->continuous_read_mode_bits);
+    }
+  }
+
+  if ( _flash_dev->supports_quad_io_writes ) QSPI0.setWriteMode(QSPI_XFER_1_4_4);
+}
+
+/**
+ * Complete pending writes, leave the flash idle in single line mode and
+ * disable the QSPI peripheral. The flash stays powered with quad enable and
+ * 4-byte addresses set, so that begin() with warm_start resumes it quickly.
+ * @return true if pending writes completed
+ */
+bool Adafruit_QSPI_Flash::end(void)
+{
+  if ( !_flash_dev ) return true;
+
+  bool const ok = sync();
+  unmapMemory();
+
+  if ( _qpi )
+  {
+    QSPI0.runCommand(QSPI_CMD_EXIT_QPI);
+    QSPI0.setQPI(false);
+    _qpi = false;
+  }
+
+  // Also takes the flash out of continuous read mode
+  QSPI0.runCommand(QSPI_CMD_WRITE_DISABLE);
+
+  QSPI0.end();
+
+  _end_dev = _flash_dev;
+  _flash_dev = NULL;
+
+  return ok;
+}
+
 /**************************************************************************/
 /*! 
    @brief read the manufacturer ID and device ID
@@ -210,6 +605,7 @@ uint32_t Adafruit_QSPI_Flash::GetJEDECID (void)
 uint8_t Adafruit_QSPI_Flash::readStatus(void)
 {
 	uint8_t r;
+	qspi_stats_event(QSPI_STATS_STATUS_POLL);
 	QSPI0.readCommand(QSPI_CMD_READ_STATUS, &r, 1);
 	return r;
 }
@@ -245,9 +641,162 @@ uint32_t Adafruit_QSPI_Flash::readBuffer (uint32_t address, uint8_t *buffer, uin
 {
   if (!_flash_dev) return 0;
 
-  _wait_for_flash_ready();
+  // Appended data must be in flash before it is read back
+  if ( _append_len && address < _append_addr + _append_len && _append_addr < address + len )
+  {
+    if ( !_flush_append() ) return 0;
+  }
+
+  if ( _cache ) return _cached_read(address, buffer, len);
 
-  return QSPI0.readMemory(address, buffer, len) ? len : 0;
+  if ( !_wait_for_read(address, len) ) return 0;
+
+  bool const result = _read_memory(address, buffer, len);
+  _resume_erase();
+
+  return result ? len : 0;
+}
+
+/**
+ * Wait until a range can be read. A sector/block erase that does not cover
+ * the range is suspended instead of waited for, if the device supports it;
+ * _resume_erase() must then be called once read. The erase is first given
+ * QSPI_FLASH_RESUME_MIN_US since the last resume so that it still completes
+ * under a stream of reads.
+ * @param addr  address of the range
+ * @param len   number of bytes
+ * @return true if the range can be read
+ */
+bool Adafruit_QSPI_Flash::_wait_for_read(uint32_t addr, uint32_t len)
+{
+  uint32_t const suspend_us = _flash_dev->erase_suspend_us;
+
+  if ( !_wip || !_erase_size || !suspend_us ) return _wait_for_flash_ready();
+
+  // Data of the sector/block being erased is undefined while suspended
+  if ( addr < _erase_addr + _erase_size && _erase_addr < addr + len ) return _wait_for_flash_ready();
+
+  // Nothing to suspend once the erase has completed
+  if ( !(readStatus() & 0x03) )
+  {
+    _wip = false;
+    return true;
+  }
+
+  while ( (uint32_t) (micros() - _resume_us) < QSPI_FLASH_RESUME_MIN_US ) yield();
+
+  _suspend_start_us = micros();
+  QSPI0.runCommand(QSPI_CMD_ERASE_SUSPEND);
+  qspi_stats_event(QSPI_STATS_ERASE_SUSPEND);
+  delayMicroseconds(suspend_us);
+
+  // Not ready after tSUS: the device ignored the suspend, cancel it in case
+  // it is only late and wait for the erase instead
+  if ( readStatus() & 0x01 )
+  {
+    QSPI0.runCommand(QSPI_CMD_ERASE_RESUME);
+    _resume_us = micros();
+    return _wait_for_flash_ready();
+  }
+
+  // Either suspended or already complete, resume is ignored by the latter
+  _erase_suspended = true;
+  _wip = false;
+
+  return true;
+}
+
+/**
+ * Resume the erase suspended by _wait_for_read(), if any. Its typical time is
+ * extended by the time spent suspended.
+ */
+void Adafruit_QSPI_Flash::_resume_erase(void)
+{
+  if ( !_erase_suspended ) return;
+
+  QSPI0.runCommand(QSPI_CMD_ERASE_RESUME);
+
+  _resume_us = micros();
+  _wait_start_us += _resume_us - _suspend_start_us;
+  _erase_suspended = false;
+  _wip = true;
+}
+
+/**
+ * Attach a read cache. Data is then read from flash one cache line at a time,
+ * and hits are served even while the flash is busy programming/erasing.
+ * Program/erase issued directly through QSPI0 are not seen by the cache.
+ * Dirty sectors of the previous cache are written to flash first.
+ * @param cache  initialized cache, NULL to detach
+ */
+void Adafruit_QSPI_Flash::setCache(Adafruit_QSPI_Cache* cache)
+{
+  if ( _cache && cache != _cache ) sync();
+
+  _cache = cache;
+  if ( _cache ) _cache->invalidateAll();
+
+  if ( !_cache || _cache->lineSize() != QSPI_FLASH_SECTOR_SIZE ) _write_back = false;
+}
+
+/**
+ * Get the cache line holding addr, allocating it on a miss. A dirty victim is
+ * written to flash before its line is reused.
+ * @param addr  flash address
+ * @param fill  read the line from flash, false if the caller overwrites all of it
+ * @return line contents, NULL on error
+ */
+uint8_t* Adafruit_QSPI_Flash::_cache_line(uint32_t addr, bool fill)
+{
+  uint8_t* line = _cache->lookup(addr);
+  if ( line ) return line;
+
+  uint32_t victim_addr;
+  uint8_t const* victim_data;
+
+  if ( _cache->dirtyVictim(&victim_addr, &victim_data) && !_flush_sector(victim_addr, victim_data) ) return NULL;
+
+  line = _cache->allocate(addr);
+
+  if ( fill )
+  {
+    uint32_t const line_addr = addr & ~(_cache->lineSize() - 1);
+
+    bool const result = _wait_for_read(line_addr, _cache->lineSize()) &&
+                        _read_memory(line_addr, line, _cache->lineSize());
+    _resume_erase();
+
+    if ( !result )
+    {
+      _cache->invalidate(addr, 1);
+      return NULL;
+    }
+  }
+
+  return line;
+}
+
+uint32_t Adafruit_QSPI_Flash::_cached_read(uint32_t addr, uint8_t* buffer, uint32_t len)
+{
+  uint32_t const line_size = _cache->lineSize();
+  uint32_t remain = len;
+
+  while ( remain )
+  {
+    uint32_t const offset = addr & (line_size - 1);
+    uint32_t const count = min(remain, line_size - offset);
+
+    uint8_t const* line = _cache_line(addr, true);
+    if ( !line ) return 0;
+
+    memcpy(buffer, line + offset, count);
+
+    remain -= count;
+    buffer += count;
+    addr += count;
+  }
+
+  return len;
 }
 
 /**
@@ -261,27 +810,342 @@ uint32_t Adafruit_QSPI_Flash::readBuffer (uint32_t address, uint8_t *buffer, uin
 uint32_t Adafruit_QSPI_Flash::writeBuffer (uint32_t addr, uint8_t *data, uint32_t len)
 {
   if (!_flash_dev) return 0;
+  if ( !_flush_append() ) return 0;
 
   uint32_t remain = len;
 
-	//write one page at a time
+	//write one page at a time, program wraps around within the page
 	while(remain)
 	{
-	  _wait_for_flash_ready();
-	  writeEnable();
+	  uint32_t const toWrite = min(remain, QSPI_FLASH_PAGE_SIZE - (addr & (QSPI_FLASH_PAGE_SIZE - 1)));
 
-	  uint16_t const toWrite = min(remain, QSPI_FLASH_PAGE_SIZE);
+	  bool skip = is_erased(data, toWrite);
 
-		if ( !QSPI0.writeMemory(addr, data, toWrite) ) break;
+	  if ( !skip && _diff_write )
+	  {
+	    uint32_t current[QSPI_FLASH_PAGE_SIZE/4];
+	    if ( readBuffer(addr, (uint8_t*) current, toWrite) != toWrite ) break;
+
+	    skip = !(compare_bits((uint8_t*) current, data, toWrite) & BITS_TO_CLEAR);
+	  }
+
+		if ( !skip && !_program_page(addr, data, toWrite) ) break;
 
 		remain -= toWrite;
 		data += toWrite;
 		addr += toWrite;
 	}
 
+	if ( !_wait_if_mapped() ) return 0;
+
 	return len - remain;
 }
 
+//------------- QSPI0 transfers, accounted in the statistics -------------//
+bool Adafruit_QSPI_Flash::_read_memory(uint32_t addr, uint8_t* data, uint32_t len)
+{
+  uint32_t const start_us = qspi_stats_start();
+  bool const result = QSPI0.readMemory(addr, data, len);
+  qspi_stats_record(QSPI_STATS_READ, len, start_us);
+
+  return result;
+}
+
+bool Adafruit_QSPI_Flash::_write_memory(uint32_t addr, uint8_t const* data, uint32_t len)
+{
+  uint32_t const start_us = qspi_stats_start();
+  bool const result = QSPI0.writeMemory(addr, (uint8_t*) data, len);
+  qspi_stats_record(QSPI_STATS_PROGRAM, len, start_us);
+
+  return result;
+}
+
+bool Adafruit_QSPI_Flash::_erase_command(uint8_t command, uint32_t addr, uint32_t size)
+{
+  uint32_t const start_us = qspi_stats_start();
+  bool const result = (command == QSPI_CMD_ERASE_CHIP) ? QSPI0.runCommand(command) : QSPI0.eraseCommand(command, addr);
+  qspi_stats_record(QSPI_STATS_ERASE, size, start_us);
+
+  return result;
+}
+
+/**
+ * Program up to a page, data must not cross a page boundary
+ * @param addr  address to write
+ * @param data  writing data
+ * @param len   number of bytes
+ * @return true if success
+ */
+bool Adafruit_QSPI_Flash::_program_page(uint32_t addr, uint8_t const* data, uint32_t len)
+{
+  if ( !_wait_for_flash_ready() ) return false;
+  writeEnable();
+
+  if ( !_write_memory(addr, data, len) ) return false;
+  _start_wait(_flash_dev->typical_page_program_us);
+
+  if ( _cache ) _cache->program(addr, data, len);
+
+  return true;
+}
+
+/**
+ * Write data to erased flash like writeBuffer(), but consecutive calls are
+ * combined: data is staged in RAM and programmed once a page is complete, so
+ * that a stream of small records costs one page program per 256 bytes.
+ * A partial page is programmed when the next call is not contiguous, on any
+ * other read/write/erase touching flash, and on sync().
+ * @param addr  address to write
+ * @param data  writing data
+ * @param len   number of bytes to write
+ * @return number of bytes accepted
+ */
+uint32_t Adafruit_QSPI_Flash::appendBuffer(uint32_t addr, uint8_t const* data, uint32_t len)
+{
+  if (!_flash_dev) return 0;
+
+  if ( addr != _append_addr + _append_len && !_flush_append() ) return 0;
+
+  uint32_t remain = len;
+
+  while ( remain )
+  {
+    uint32_t const page_remain = QSPI_FLASH_PAGE_SIZE - (addr & (QSPI_FLASH_PAGE_SIZE - 1));
+    uint32_t const count = min(remain, page_remain);
+
+    if ( !_append_len ) _append_addr = addr;
+
+    memcpy(_append_buf + _append_len, data, count);
+    _append_len += count;
+
+    if ( count == page_remain && !_flush_append() ) break;
+
+    remain -= count;
+    data += count;
+    addr += count;
+  }
+
+  if ( !_wait_if_mapped() ) return 0;
+
+  return len - remain;
+}
+
+/**
+ * Program the data staged by appendBuffer(), if any
+ * @return true if success
+ */
+bool Adafruit_QSPI_Flash::_flush_append(void)
+{
+  if ( !_append_len ) return true;
+
+  uint16_t const len = _append_len;
+  _append_len = 0;
+
+  return _program_page(_append_addr, _append_buf, len);
+}
+
+/**
+ * Write data without erasing first: sectors are read into the cache, updated
+ * there, then written back with one sector erase and the page programs.
+ * In write-back mode (see setWriteBack()) sectors stay dirty in the cache so
+ * that later updates of the same sector are merged, and are only written on
+ * sync(), task() or when evicted. Otherwise they are written before returning.
+ * Requires a cache with QSPI_FLASH_SECTOR_SIZE lines.
+ * @param addr  address to write
+ * @param data  writing data
+ * @param len   number of bytes to write
+ * @return number of bytes written
+ */
+uint32_t Adafruit_QSPI_Flash::updateBuffer(uint32_t addr, uint8_t const* data, uint32_t len)
+{
+  if ( !_flash_dev || !_cache || _cache->lineSize() != QSPI_FLASH_SECTOR_SIZE ) return 0;
+  if ( !_flush_append() ) return 0;
+
+  uint32_t remain = len;
+
+  while ( remain )
+  {
+    uint32_t const offset = addr & (QSPI_FLASH_SECTOR_SIZE - 1);
+    uint32_t const count = min(remain, QSPI_FLASH_SECTOR_SIZE - offset);
+
+    // No need to read a sector that is overwritten entirely
+    uint8_t* line = _cache_line(addr, count != QSPI_FLASH_SECTOR_SIZE);
+    if ( !line ) break;
+
+    memcpy(line + offset, data, count);
+    _cache->markDirty(addr);
+
+    if ( !_write_back && !_flush_sector(addr - offset, line) ) break;
+
+    remain -= count;
+    data += count;
+    addr += count;
+  }
+
+  if ( !_write_back && !_wait_if_mapped() ) return 0;
+
+  return len - remain;
+}
+
+/**
+ * Enable or disable the write-back mode of updateBuffer(). Disabling it
+ * writes all dirty sectors to flash.
+ * @param enable      true to defer writes
+ * @param max_age_ms  task() writes sectors that have been dirty for at least
+ *                    this long, 0 to only write on sync() and eviction
+ * @return false if there is no cache with QSPI_FLASH_SECTOR_SIZE lines, or
+ *         dirty sectors could not be written
+ */
+bool Adafruit_QSPI_Flash::setWriteBack(bool enable, uint32_t max_age_ms)
+{
+  if ( !enable )
+  {
+    _write_back = false;
+    return sync();
+  }
+
+  if ( !_cache || _cache->lineSize() != QSPI_FLASH_SECTOR_SIZE ) return false;
+
+  _write_back = true;
+  _write_back_max_ms = max_age_ms;
+
+  return true;
+}
+
+/**
+ * Write all dirty sectors to flash and wait for completion, e.g before
+ * power off or when data must survive a reset.
+ * @return true if success
+ */
+bool Adafruit_QSPI_Flash::sync(void)
+{
+  if ( !_flush_append() ) return false;
+  if ( !_cache ) return _wait_for_flash_ready();
+
+  uint32_t addr, since_ms;
+  uint8_t const* data;
+
+  while ( _cache->oldestDirty(&addr, &data, &since_ms) )
+  {
+    if ( !_flush_sector(addr, data) ) return false;
+  }
+
+  return _wait_for_flash_ready();
+}
+
+/**
+ * Write dirty sectors older than the write-back deadline, should be called
+ * periodically e.g from loop()
+ */
+void Adafruit_QSPI_Flash::task(void)
+{
+  if ( !_cache || !_write_back || !_write_back_max_ms ) return;
+
+  uint32_t addr, since_ms;
+  uint8_t const* data;
+
+  while ( _cache->oldestDirty(&addr, &data, &since_ms) && millis() - since_ms >= _write_back_max_ms )
+  {
+    if ( !_flush_sector(addr, data) ) return;
+  }
+}
+
+/**
+ * Erase a sector and program it with the contents of its cache line, the
+ * line is then clean. The last page program may still be in progress.
+ * All 0xFF pages are not programmed. With differential write, the erase is
+ * skipped if the flash only needs bits cleared, and so are unchanged pages.
+ * @param addr  sector address
+ * @param data  sector contents
+ * @return true if success
+ */
+bool Adafruit_QSPI_Flash::_flush_sector(uint32_t addr, uint8_t const* data)
+{
+  enum { SECTOR_PAGES = QSPI_FLASH_SECTOR_SIZE/QSPI_FLASH_PAGE_SIZE };
+
+  uint32_t program_mask = 0; // pages to program
+  bool erase = true;
+
+  if ( _diff_write )
+  {
+    // Flash itself, the cache line holds the new contents
+    uint32_t current[QSPI_FLASH_PAGE_SIZE/4];
+    erase = false;
+
+    for(uint32_t i = 0; i < SECTOR_PAGES && !erase; i++)
+    {
+      uint32_t const page = i*QSPI_FLASH_PAGE_SIZE;
+
+      if ( !_wait_for_flash_ready() || !_read_memory(addr + page, (uint8_t*) current, QSPI_FLASH_PAGE_SIZE) ) return false;
+
+      uint8_t const diff = compare_bits((uint8_t*) current, data + page, QSPI_FLASH_PAGE_SIZE);
+
+      if ( diff & BITS_TO_SET ) erase = true;
+      if ( diff & BITS_TO_CLEAR ) program_mask |= 1UL << i;
+    }
+  }
+
+  if ( erase )
+  {
+    if ( !_erase(addr, QSPI_FLASH_SECTOR_SIZE) ) return false;
+
+    program_mask = 0;
+    for(uint32_t i = 0; i < SECTOR_PAGES; i++)
+    {
+      if ( !is_erased(data + i*QSPI_FLASH_PAGE_SIZE, QSPI_FLASH_PAGE_SIZE) ) program_mask |= 1UL << i;
+    }
+  }
+
+  for(uint32_t i = 0; i < SECTOR_PAGES; i++)
+  {
+    uint32_t const page = i*QSPI_FLASH_PAGE_SIZE;
+    if ( !(program_mask & (1UL << i)) ) continue;
+
+    if ( !_wait_for_flash_ready() ) return false;
+    writeEnable();
+
+    if ( !_write_memory(addr + page, data + page, QSPI_FLASH_PAGE_SIZE) ) return false;
+    _start_wait(_flash_dev->typical_page_program_us);
+  }
+
+  _cache->markClean(addr);
+
+  return true;
+}
+
+/**
+ * Map a region of external flash into the address space for in-place reads,
+ * e.g fonts or lookup tables that would otherwise be copied to SRAM.
+ * While mapped, writeBuffer() and erase functions only return once the flash
+ * has completed the operation so that the region stays readable.
+ * @param addr  address of the region
+ * @param len   size of the region
+ * @return pointer to the region, or NULL if not supported by the port
+ */
+uint8_t const* Adafruit_QSPI_Flash::mapMemory(uint32_t addr, uint32_t len)
+{
+  if ( !_flash_dev || (uint64_t) addr + len > _flash_dev->total_size ) return NULL;
+
+  // Mapped reads bypass the caches, they must not hold newer data
+  if ( !sync() ) return NULL;
+
+  uint8_t const* ptr = QSPI0.mapMemory(addr, len);
+  _mapped = (ptr != NULL);
+
+  return ptr;
+}
+
+/**
+ * Leave memory-mapped mode, pointers returned by mapMemory() become invalid
+ */
+void Adafruit_QSPI_Flash::unmapMemory(void)
+{
+  if ( !_mapped ) return;
+
+  QSPI0.unmapMemory();
+  _mapped = false;
+}
+
 /**
  * Read one byte from flash device
  * @param addr address to read
@@ -290,7 +1154,7 @@ uint32_t Adafruit_QSPI_Flash::writeBuffer (uint32_t addr, uint8_t *data, uint32_
 uint8_t Adafruit_QSPI_Flash::read8(uint32_t addr)
 {
 	uint8_t ret;
-	return readBuffer(addr, &ret, sizeof(ret)) ? 0xff : ret;
+	return readBuffer(addr, &ret, sizeof(ret)) ? ret : 0xff;
 }
 
 /**
@@ -301,7 +1165,7 @@ uint8_t Adafruit_QSPI_Flash::read8(uint32_t addr)
 uint16_t Adafruit_QSPI_Flash::read16(uint32_t addr)
 {
 	uint16_t ret;
-	return readBuffer(addr, (uint8_t*) &ret, sizeof(ret)) ? 0xffff : ret;
+	return readBuffer(addr, (uint8_t*) &ret, sizeof(ret)) ? ret : 0xffff;
 }
 
 /**
@@ -312,7 +1176,7 @@ uint16_t Adafruit_QSPI_Flash::read16(uint32_t addr)
 uint32_t Adafruit_QSPI_Flash::read32(uint32_t addr)
 {
 	uint32_t ret;
-	return readBuffer(addr, (uint8_t*) &ret, sizeof(ret)) ? 0xffffffff : ret;
+	return readBuffer(addr, (uint8_t*) &ret, sizeof(ret)) ? ret : 0xffffffff;
 }
 
 /**************************************************************************/
@@ -326,11 +1190,16 @@ bool Adafruit_QSPI_Flash::chipErase(void)
   if (!_flash_dev) return false;
 
   // We need to wait for any writes to finish
-  _wait_for_flash_ready();
+  if ( !_flush_append() || !_wait_for_flash_ready() ) return false;
 
 	writeEnable();
 
-	return QSPI0.runCommand(QSPI_CMD_ERASE_CHIP);
+	if ( !_erase_command(QSPI_CMD_ERASE_CHIP, 0, _flash_dev->total_size) ) return false;
+	_start_wait(1000UL*_flash_dev->typical_chip_erase_ms);
+
+	if ( _cache ) _cache->erase(0, _flash_dev->total_size);
+
+	return _wait_if_mapped();
 }
 
 /**************************************************************************/
@@ -344,12 +1213,258 @@ bool Adafruit_QSPI_Flash::eraseSector (uint32_t sectorNumber)
 {
   if (!_flash_dev) return false;
 
-  // Before we erase the sector we need to wait for any writes to finish
-  _wait_for_flash_ready();
+  uint32_t const addr = sectorNumber * QSPI_FLASH_SECTOR_SIZE;
+
+  // Pending appends go first, _erase() waits for any writes to finish
+  if ( !_flush_append() || !_erase(addr, QSPI_FLASH_SECTOR_SIZE) ) return false;
+
+	if ( _cache ) _cache->erase(addr, QSPI_FLASH_SECTOR_SIZE);
+
+	return _wait_if_mapped();
+}
+
+/**
+ * Erase a range with the erase operations that take the least time in total:
+ * 64KB blocks, 32KB blocks if supported and 4KB sectors, or a chip erase if the
+ * range is the whole device.
+ * With skip_erased, sectors are read first, which costs a few milliseconds per
+ * 64KB against 100ms or more per erase: blank sectors are not erased, and
+ * blocks with only a few used sectors are erased sector by sector.
+ * @param addr         start address, multiple of QSPI_FLASH_SECTOR_SIZE
+ * @param len          number of bytes, multiple of QSPI_FLASH_SECTOR_SIZE
+ * @param skip_erased  do not erase blank sectors
+ * @return true if success
+ */
+bool Adafruit_QSPI_Flash::eraseRange(uint32_t addr, uint32_t len, bool skip_erased)
+{
+  if (!_flash_dev) return false;
+
+  if ( ((addr | len) & (QSPI_FLASH_SECTOR_SIZE - 1)) || (uint64_t) addr + len > _flash_dev->total_size ) return false;
+
+  if ( addr == 0 && len == _flash_dev->total_size && !skip_erased ) return chipErase();
+
+  if ( !_flush_append() ) return false;
+
+  uint32_t const start = addr;
+  uint32_t const end = addr + len;
+  bool result = true;
+
+  while ( result && addr < end )
+  {
+    // Largest aligned block that fits
+    uint32_t size = QSPI_FLASH_SECTOR_SIZE;
+
+    if ( !(addr & (QSPI_FLASH_BLOCK_SIZE - 1)) && end - addr >= QSPI_FLASH_BLOCK_SIZE )
+    {
+      size = QSPI_FLASH_BLOCK_SIZE;
+    }
+    else if ( _flash_dev->typical_block32_erase_ms &&
+              !(addr & (QSPI_FLASH_BLOCK32_SIZE - 1)) && end - addr >= QSPI_FLASH_BLOCK32_SIZE )
+    {
+      size = QSPI_FLASH_BLOCK32_SIZE;
+    }
+
+    uint32_t sector_mask = 0xffffffff;
+
+    result = (!skip_erased || _blank_sectors(addr, size, &sector_mask)) &&
+             _erase_sectors(addr, size, sector_mask);
 
+    if ( result ) addr += size;
+  }
+
+  // Skipped sectors read as erased as well
+  if ( _cache ) _cache->erase(start, addr - start);
+
+  return _wait_if_mapped() && result;
+}
+
+/// Typical time of an erase, 0 if not supported
+uint32_t Adafruit_QSPI_Flash::_erase_ms(uint32_t size)
+{
+  switch ( size )
+  {
+    case QSPI_FLASH_SECTOR_SIZE : return _flash_dev->typical_sector_erase_ms;
+    case QSPI_FLASH_BLOCK32_SIZE: return _flash_dev->typical_block32_erase_ms;
+    case QSPI_FLASH_BLOCK_SIZE  : return _flash_dev->typical_block_erase_ms;
+    default: return 0;
+  }
+}
+
+/// Erase a sector or block, without updating the cache
+bool Adafruit_QSPI_Flash::_erase(uint32_t addr, uint32_t size)
+{
+  uint8_t const command = (size == QSPI_FLASH_BLOCK_SIZE  ) ? QSPI_CMD_ERASE_BLOCK :
+                          (size == QSPI_FLASH_BLOCK32_SIZE) ? QSPI_CMD_ERASE_BLOCK32 : QSPI_CMD_ERASE_SECTOR;
+
+  if ( !_wait_for_flash_ready() ) return false;
   writeEnable();
 
-	return QSPI0.eraseCommand(QSPI_CMD_ERASE_SECTOR, sectorNumber * QSPI_FLASH_SECTOR_SIZE);
+  if ( !_erase_command(command, addr, size) ) return false;
+  _start_erase_wait(addr, size, 1000UL*_erase_ms(size));
+
+  return true;
+}
+
+/// Next smaller erase size
+static uint32_t erase_sub_size(external_flash_device const* dev, uint32_t size)
+{
+  return (size == Adafruit_QSPI_Flash::QSPI_FLASH_BLOCK_SIZE && dev->typical_block32_erase_ms) ?
+         Adafruit_QSPI_Flash::QSPI_FLASH_BLOCK32_SIZE : Adafruit_QSPI_Flash::QSPI_FLASH_SECTOR_SIZE;
+}
+
+/**
+ * Least typical time to erase the sectors of sector_mask within a block,
+ * erasing the whole block or splitting it into smaller erases
+ * @param size         block size
+ * @param sector_mask  bit n set if sector n of the block must be erased
+ * @return time in ms
+ */
+uint32_t Adafruit_QSPI_Flash::_erase_cost(uint32_t size, uint32_t sector_mask)
+{
+  uint32_t const sectors = size/QSPI_FLASH_SECTOR_SIZE;
+
+  sector_mask &= 0xffffffff >> (32 - sectors);
+  if ( !sector_mask ) return 0;
+
+  uint32_t const whole = _erase_ms(size);
+  if ( size == QSPI_FLASH_SECTOR_SIZE ) return whole;
+
+  uint32_t const sub_size = erase_sub_size(_flash_dev, size);
+  uint32_t const sub_sectors = sub_size/QSPI_FLASH_SECTOR_SIZE;
+  uint32_t split = 0;
+
+  for(uint32_t i = 0; i < sectors; i += sub_sectors)
+  {
+    split += _erase_cost(sub_size, sector_mask >> i);
+  }
+
+  return min(whole, split);
+}
+
+/// Erase the sectors of sector_mask within a block, see _erase_cost()
+bool Adafruit_QSPI_Flash::_erase_sectors(uint32_t addr, uint32_t size, uint32_t sector_mask)
+{
+  uint32_t const cost = _erase_cost(size, sector_mask);
+
+  if ( !cost ) return true;
+  if ( cost == _erase_ms(size) ) return _erase(addr, size);
+
+  uint32_t const sub_size = erase_sub_size(_flash_dev, size);
+  uint32_t const sub_sectors = sub_size/QSPI_FLASH_SECTOR_SIZE;
+
+  for(uint32_t i = 0; i*QSPI_FLASH_SECTOR_SIZE < size; i += sub_sectors)
+  {
+    if ( !_erase_sectors(addr + i*QSPI_FLASH_SECTOR_SIZE, sub_size, sector_mask >> i) ) return false;
+  }
+
+  return true;
+}
+
+/**
+ * Find the sectors of a block that are not blank
+ * @param addr         block address
+ * @param size         block size
+ * @param sector_mask  bit n set if sector n is not blank
+ * @return true if success
+ */
+bool Adafruit_QSPI_Flash::_blank_sectors(uint32_t addr, uint32_t size, uint32_t* sector_mask)
+{
+  uint32_t buf[QSPI_FLASH_PAGE_SIZE/4];
+
+  *sector_mask = 0;
+
+  for(uint32_t i = 0; i*QSPI_FLASH_SECTOR_SIZE < size; i++)
+  {
+    for(uint32_t offset = 0; offset < QSPI_FLASH_SECTOR_SIZE; offset += sizeof(buf))
+    {
+      uint32_t const page_addr = addr + i*QSPI_FLASH_SECTOR_SIZE + offset;
+
+      if ( !_wait_for_flash_ready() || !_read_memory(page_addr, (uint8_t*) buf, sizeof(buf)) ) return false;
+
+      if ( !is_erased((uint8_t*) buf, sizeof(buf)) )
+      {
+        *sector_mask |= 1UL << i;
+        break;
+      }
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Check that a range reads as 0xFF, e.g before programming it
+ * @param addr  address of the range
+ * @param len   number of bytes
+ * @return true if erased, false if not or on read error
+ */
+bool Adafruit_QSPI_Flash::isErased(uint32_t addr, uint32_t len)
+{
+  uint32_t buf[QSPI_FLASH_SCAN_CHUNK/4];
+
+  while ( len )
+  {
+    uint32_t const count = min(len, (uint32_t) sizeof(buf));
+
+    if ( readBuffer(addr, (uint8_t*) buf, count) != count ) return false;
+    if ( !is_erased((uint8_t*) buf, count) ) return false;
+
+    addr += count;
+    len -= count;
+  }
+
+  return true;
+}
+
+/**
+ * Compare flash contents with data, e.g after writing it
+ * @param addr  address of the range
+ * @param data  expected contents
+ * @param len   number of bytes
+ * @return true if equal, false if not or on read error
+ */
+bool Adafruit_QSPI_Flash::verify(uint32_t addr, uint8_t const* data, uint32_t len)
+{
+  uint32_t buf[QSPI_FLASH_SCAN_CHUNK/4];
+
+  while ( len )
+  {
+    uint32_t const count = min(len, (uint32_t) sizeof(buf));
+
+    if ( readBuffer(addr, (uint8_t*) buf, count) != count ) return false;
+    if ( memcmp(buf, data, count) ) return false;
+
+    addr += count;
+    data += count;
+    len -= count;
+  }
+
+  return true;
+}
+
+/**
+ * CRC-32 of flash contents, same as zlib crc32()
+ * @param addr  address of the range
+ * @param len   number of bytes
+ * @param crc   CRC of preceding data to continue, 0 to start
+ * @return CRC of the range, 0 on read error
+ */
+uint32_t Adafruit_QSPI_Flash::crc32(uint32_t addr, uint32_t len, uint32_t crc)
+{
+  uint32_t buf[QSPI_FLASH_SCAN_CHUNK/4];
+
+  while ( len )
+  {
+    uint32_t const count = min(len, (uint32_t) sizeof(buf));
+
+    if ( readBuffer(addr, (uint8_t*) buf, count) != count ) return 0;
+    crc = qspi_crc32(crc, (uint8_t*) buf, count);
+
+    addr += count;
+    len -= count;
+  }
+
+  return crc;
 }
 
 /**
@@ -361,10 +1476,12 @@ bool Adafruit_QSPI_Flash::eraseBlock  (uint32_t blockNumber)
 {
   if (!_flash_dev) return false;
 
-  // Before we erase the sector we need to wait for any writes to finish
-  _wait_for_flash_ready();
+  uint32_t const addr = blockNumber * QSPI_FLASH_BLOCK_SIZE;
 
-  writeEnable();
+  // Pending appends go first, _erase() waits for any writes to finish
+  if ( !_flush_append() || !_erase(addr, QSPI_FLASH_BLOCK_SIZE) ) return false;
+
+  if ( _cache ) _cache->erase(addr, QSPI_FLASH_BLOCK_SIZE);
 
-  return QSPI0.eraseCommand(QSPI_CMD_ERASE_BLOCK, blockNumber * QSPI_FLASH_BLOCK_SIZE);
+  return _wait_if_mapped();
 }
@@ -31,6 +31,7 @@
 #include "Adafruit_SPIFlash.h"
 
 #include "external_flash_device.h"
+#include "Adafruit_QSPI_Cache.h"
 
 /**************************************************************************/
 /*! 
@@ -44,6 +45,7 @@ public:
   /// Constant that is (mostly) true to all external flash devices
   enum {
     QSPI_FLASH_BLOCK_SIZE  = 64*1024,
+    QSPI_FLASH_BLOCK32_SIZE = 32*1024,
     QSPI_FLASH_SECTOR_SIZE = 4*1024,
     QSPI_FLASH_PAGE_SIZE   = 256,
   };
@@ -52,8 +54,12 @@ public:
 	~Adafruit_QSPI_Flash() {}
 
 	bool begin(void);
+	bool begin(external_flash_device const* flash_dev, bool warm_start = false);
 	bool end(void);
 
+	/// @return description of the flash in use, NULL before begin(), after a failed begin() and after end()
+	external_flash_device const* getFlashDevice(void) { return _flash_dev; }
+
 	uint8_t readStatus(void);
 	uint8_t readStatus2(void);
 	bool writeEnable(void);
@@ -65,10 +71,37 @@ public:
 	
 	uint32_t readBuffer  (uint32_t address, uint8_t *buffer, uint32_t len);
 	uint32_t writeBuffer (uint32_t address, uint8_t *buffer, uint32_t len);
+	uint32_t appendBuffer(uint32_t address, uint8_t const *buffer, uint32_t len);
 
 	bool eraseSector(uint32_t sectorNumber);
 	bool eraseBlock (uint32_t blockNumber);
 	bool chipErase  (void);
+	bool eraseRange (uint32_t addr, uint32_t len, bool skip_erased = false);
+
+	// Check contents without a buffer of the whole range
+	bool     isErased(uint32_t addr, uint32_t len);
+	bool     verify  (uint32_t addr, uint8_t const* data, uint32_t len);
+	uint32_t crc32   (uint32_t addr, uint32_t len, uint32_t crc = 0);
+
+	// Memory-mapped read
+	uint8_t const* mapMemory(uint32_t addr, uint32_t len);
+	void unmapMemory(void);
+
+	// Read cache
+	void setCache(Adafruit_QSPI_Cache* cache);
+	Adafruit_QSPI_Cache* getCache(void) { return _cache; }
+
+	// Read-modify-write through a cache of sector sized lines
+	uint32_t updateBuffer(uint32_t addr, uint8_t const* data, uint32_t len);
+	bool setWriteBack(bool enable, uint32_t max_age_ms = 0);
+	bool sync(void);
+	void task(void);
+
+	/// Compare with flash contents before programming: writeBuffer() skips pages
+	/// that would not change, and sectors written back from the cache are only
+	/// erased when a bit must go from 0 to 1.
+	/// @param enable  true to enable
+	void setDifferentialWrite(bool enable) { _diff_write = enable; }
 
 	// Helper
 	uint8_t  read8(uint32_t addr);
@@ -82,11 +115,76 @@ public:
 
 private:
 	external_flash_device const * _flash_dev;
+	external_flash_device const * _end_dev; // device before end(), for a warm start
+	bool _qpi;
+	bool _mapped;
+	Adafruit_QSPI_Cache* _cache;
+
+	// updateBuffer() leaves dirty sectors in the cache until sync()/eviction,
+	// or until task() finds them older than _write_back_max_ms (0: no deadline)
+	bool     _write_back;
+	uint32_t _write_back_max_ms;
+	bool     _diff_write;
+
+	// appendBuffer() data not programmed yet, always within one page
+	uint8_t  _append_buf[QSPI_FLASH_PAGE_SIZE];
+	uint32_t _append_addr;
+	uint16_t _append_len;
+
+	// last program/erase, used to schedule status polling. Operations issued
+	// directly through QSPI0 are not tracked.
+	bool     _wip;
+	uint32_t _wait_start_us;
+	uint32_t _wait_typical_us;
+
+	// sector/block erase in progress that reads can suspend, _erase_size is 0 otherwise
+	uint32_t _erase_addr;
+	uint32_t _erase_size;
+	bool     _erase_suspended;
+	uint32_t _suspend_start_us;
+	uint32_t _resume_us;
+
+	void _start_wait(uint32_t typical_us)
+	{
+	  _wip = true;
+	  _wait_start_us = micros();
+	  _wait_typical_us = typical_us;
+	  _erase_size = 0;
+	}
+
+	void _start_erase_wait(uint32_t addr, uint32_t size, uint32_t typical_us)
+	{
+	  _start_wait(typical_us);
+	  _erase_addr = addr;
+	  _erase_size = size;
+	}
 
-	void _wait_for_flash_ready(void)
+	bool _warm_start(external_flash_device const* flash_dev);
+	bool _configure(void);
+	bool _wait_for_flash_ready(void);
+	bool _wait_async(void);
+	bool _wait_busy(void);
+	bool _read_memory(uint32_t addr, uint8_t* data, uint32_t len);
+	bool _write_memory(uint32_t addr, uint8_t const* data, uint32_t len);
+	bool _erase_command(uint8_t command, uint32_t addr, uint32_t size);
+	bool _wait_for_read(uint32_t addr, uint32_t len);
+	void _resume_erase(void);
+	uint32_t _cached_read(uint32_t addr, uint8_t* buffer, uint32_t len);
+	uint8_t* _cache_line(uint32_t addr, bool fill);
+	bool _flush_sector(uint32_t addr, uint8_t const* data);
+	bool _program_page(uint32_t addr, uint8_t const* data, uint32_t len);
+	bool _flush_append(void);
+	bool _erase(uint32_t addr, uint32_t size);
+	uint32_t _erase_ms(uint32_t size);
+	uint32_t _erase_cost(uint32_t size, uint32_t sector_mask);
+	bool _erase_sectors(uint32_t addr, uint32_t size, uint32_t sector_mask);
+	bool _blank_sectors(uint32_t addr, uint32_t size, uint32_t* sector_mask);
+	void _set_transfer_modes(void);
+
+	// Mapped contents must be readable again once a program/erase returns
+	bool _wait_if_mapped(void)
 	{
-	  // both WIP and WREN bit should be clear
-	  while ( readStatus() & 0x03 ) {}
+	  return _mapped ? _wait_for_flash_ready() : true;
 	}
 };
 
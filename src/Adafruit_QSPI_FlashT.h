@@ -0,0 +1,422 @@
+/**
+ * @file Adafruit_QSPI_FlashT.h
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ADAFRUIT_QSPI_FLASHT_H_
+#define ADAFRUIT_QSPI_FLASHT_H_
+
+#include "Adafruit_QSPI.h"
+#include "external_flash_device.h"
+
+/// Declare a device type for Adafruit_QSPI_FlashT from an entry of
+/// external_flash_device.h, e.g QSPI_FLASH_DEVICE_TYPE(BoardFlash, GD25Q16C)
+#define QSPI_FLASH_DEVICE_TYPE(name, device) \
+  struct name { static constexpr external_flash_device value(void) { return device; } }
+
+/**************************************************************************/
+/*!
+    @brief  Adafruit_QSPI_Flash for builds where the flash device is known at
+    compile time. Device flags are constant expressions and the port is called
+    without virtual dispatch, so the compiler drops the code of features the
+    device does not have and can inline the transport.
+
+    Only the core API is provided: no read cache, write-back, append staging
+    or erase suspend, and it is not an Adafruit_SPIFlash (e.g for FatFs).
+    Use Adafruit_QSPI_Flash for those.
+
+    @tparam Device  type declared with QSPI_FLASH_DEVICE_TYPE()
+    @tparam Port    port class, Adafruit_QSPI_Port for QSPI0
+*/
+/**************************************************************************/
+template <class Device, class Port = Adafruit_QSPI_Port>
+class Adafruit_QSPI_FlashT
+{
+public:
+  /// Constant that is (mostly) true to all external flash devices
+  enum {
+    QSPI_FLASH_BLOCK_SIZE   = 64*1024,
+    QSPI_FLASH_BLOCK32_SIZE = 32*1024,
+    QSPI_FLASH_SECTOR_SIZE  = 4*1024,
+    QSPI_FLASH_PAGE_SIZE    = 256,
+  };
+
+  /// @param port  port of the flash
+  Adafruit_QSPI_FlashT(Port& port = QSPI0) : _port(port)
+  {
+    _wip = true;
+    _wait_start_us = 0;
+    _wait_typical_us = 0;
+  }
+
+  /// @return description of the flash
+  static constexpr external_flash_device device(void) { return Device::value(); }
+
+  /// @return flash size in bytes
+  static constexpr uint32_t size(void) { return Device::value().total_size; }
+
+  /**
+   * Initialize the port and the flash like Adafruit_QSPI_Flash::begin(), but
+   * only accept the compile-time device
+   * @return true if success
+   */
+  bool begin(void)
+  {
+    _port.Port::begin();
+
+    // QPI and continuous read mode survive a microcontroller only reset
+    if ( _port.Port::setQPI(true) )
+    {
+      _port.Port::runCommand(QSPI_CMD_EXIT_QPI);
+      _port.Port::setQPI(false);
+    }
+    // Long mode bit reset, long enough for 4-byte addresses
+    uint8_t const ff = 0xff;
+    _port.Port::writeCommand(QSPI_CMD_CONTINUOUS_READ_RESET, &ff, 1);
+
+    // Only status is readable while a program/erase from before a reset
+    // completes. All ones is an empty bus, the JEDEC ID check fails.
+    for ( uint8_t status = readStatus(); (status & 0x01) && status != 0xFF; status = readStatus() ) {}
+
+    if ( GetJEDECID() != ((uint32_t) device().manufacturer_id << 16 | device().memory_type << 8 | device().capacity) )
+    {
+      return false;
+    }
+
+    while ( readStatus() & 0x01 ) {}
+
+    // Resume an erase suspended before a microcontroller only reset
+    if ( device().erase_suspend_us && (readStatus2() & 0x80) )
+    {
+      _port.Port::runCommand(QSPI_CMD_ERASE_RESUME);
+      while ( readStatus() & 0x01 ) {}
+    }
+    while ( readStatus2() & 0x80 ) {}
+
+    _port.Port::runCommand(QSPI_CMD_ENABLE_RESET);
+    _port.Port::runCommand(QSPI_CMD_RESET);
+    delayMicroseconds(30);
+
+    _wip = true;
+    _port.Port::setClockSpeed(device().max_clock_speed_mhz*1000000UL);
+
+    if ( device().quad_enable_bit_mask )
+    {
+      uint8_t const status = device().single_status_byte ? readStatus() : readStatus2();
+
+      if ( (status & device().quad_enable_bit_mask) == 0 )
+      {
+        writeEnable();
+
+        uint8_t const full_status[2] = { 0x00, device().quad_enable_bit_mask };
+
+        if ( device().write_status_register_split )
+        {
+          _port.Port::writeCommand(QSPI_CMD_WRITE_STATUS2, full_status + 1, 1);
+        }
+        else if ( device().single_status_byte )
+        {
+          _port.Port::writeCommand(QSPI_CMD_WRITE_STATUS, full_status + 1, 1);
+        }
+        else
+        {
+          _port.Port::writeCommand(QSPI_CMD_WRITE_STATUS, full_status, 2);
+        }
+
+        _start_wait(QSPI_FLASHT_WRITE_STATUS_US);
+      }
+    }
+
+    _port.Port::runCommand(QSPI_CMD_WRITE_DISABLE);
+    if ( !_wait_for_flash_ready() ) return false;
+
+    if ( size() > (1UL << 24) )
+    {
+      _port.Port::runCommand(QSPI_CMD_ENABLE_4B_ADDR);
+      if ( !_port.Port::setAddressLength(32) )
+      {
+        _port.Port::runCommand(QSPI_CMD_EXIT_4B_ADDR);
+        return false;
+      }
+    }
+
+    _set_transfer_modes();
+
+    return true;
+  }
+
+  uint32_t GetJEDECID(void)
+  {
+    uint8_t ids[3];
+    _port.Port::readCommand(QSPI_CMD_READ_JEDEC_ID, ids, 3);
+
+    return ((uint32_t) ids[0] << 16) | (ids[1] << 8) | ids[2];
+  }
+
+  uint8_t readStatus(void)
+  {
+    uint8_t r;
+    _port.Port::readCommand(QSPI_CMD_READ_STATUS, &r, 1);
+    return r;
+  }
+
+  uint8_t readStatus2(void)
+  {
+    uint8_t r;
+    _port.Port::readCommand(QSPI_CMD_READ_STATUS2, &r, 1);
+    return r;
+  }
+
+  bool writeEnable(void)
+  {
+    return _port.Port::runCommand(QSPI_CMD_WRITE_ENABLE);
+  }
+
+  /**
+   * Read data from external flash contents
+   * @param addr    address to read
+   * @param buffer  buffer to hold data
+   * @param len     number of bytes to read
+   * @return number of bytes read
+   */
+  uint32_t readBuffer(uint32_t addr, uint8_t* buffer, uint32_t len)
+  {
+    if ( (uint64_t) addr + len > size() ) return 0;
+    if ( !_wait_for_flash_ready() ) return 0;
+
+    return _port.Port::readMemory(addr, buffer, len) ? len : 0;
+  }
+
+  /**
+   * Write data to erased flash, one page program per page crossed
+   * @param addr  address to write
+   * @param data  writing data
+   * @param len   number of bytes to write
+   * @return number of bytes written
+   */
+  uint32_t writeBuffer(uint32_t addr, uint8_t const* data, uint32_t len)
+  {
+    if ( (uint64_t) addr + len > size() ) return 0;
+
+    uint32_t remain = len;
+    while ( remain )
+    {
+      uint32_t const count = min(remain, QSPI_FLASH_PAGE_SIZE - (addr & (QSPI_FLASH_PAGE_SIZE - 1)));
+
+      if ( !_wait_for_flash_ready() ) break;
+      writeEnable();
+
+      if ( !_port.Port::writeMemory(addr, (uint8_t*) data, count) ) break;
+      _start_wait(device().typical_page_program_us);
+
+      remain -= count;
+      data   += count;
+      addr   += count;
+    }
+
+    return len - remain;
+  }
+
+  bool eraseSector(uint32_t sectorNumber)
+  {
+    return _erase(QSPI_CMD_ERASE_SECTOR, sectorNumber*QSPI_FLASH_SECTOR_SIZE, 1000UL*device().typical_sector_erase_ms);
+  }
+
+  bool eraseBlock(uint32_t blockNumber)
+  {
+    return _erase(QSPI_CMD_ERASE_BLOCK, blockNumber*QSPI_FLASH_BLOCK_SIZE, 1000UL*device().typical_block_erase_ms);
+  }
+
+  /// Erase a 32KiB block, false if the device does not support it
+  bool eraseBlock32(uint32_t blockNumber)
+  {
+    if ( !device().typical_block32_erase_ms ) return false;
+    return _erase(QSPI_CMD_ERASE_BLOCK32, blockNumber*QSPI_FLASH_BLOCK32_SIZE, 1000UL*device().typical_block32_erase_ms);
+  }
+
+  bool chipErase(void)
+  {
+    if ( !_wait_for_flash_ready() ) return false;
+    writeEnable();
+
+    if ( !_port.Port::runCommand(QSPI_CMD_ERASE_CHIP) ) return false;
+    _start_wait(1000UL*device().typical_chip_erase_ms);
+
+    return true;
+  }
+
+  /// Wait for the last program/erase to complete
+  /// @return true if ready, false on timeout
+  bool waitUntilReady(void) { return _wait_for_flash_ready(); }
+
+  uint8_t read8(uint32_t addr)
+  {
+    uint8_t ret;
+    return readBuffer(addr, &ret, sizeof(ret)) ? ret : 0xff;
+  }
+
+  uint16_t read16(uint32_t addr)
+  {
+    uint16_t ret;
+    return readBuffer(addr, (uint8_t*) &ret, sizeof(ret)) ? ret : 0xffff;
+  }
+
+  uint32_t read32(uint32_t addr)
+  {
+    uint32_t ret;
+    return readBuffer(addr, (uint8_t*) &ret, sizeof(ret)) ? ret : 0xffffffff;
+  }
+
+private:
+  /// Same wait scheme as Adafruit_QSPI_Flash
+  enum
+  {
+    QSPI_FLASHT_WRITE_STATUS_US = 15000,
+    QSPI_FLASHT_POLL_MIN_US     = 8,
+    QSPI_FLASHT_TIMEOUT_FACTOR  = 16,
+    QSPI_FLASHT_TIMEOUT_MIN_US  = 50000,
+    QSPI_FLASHT_TASK_MAX_US     = 1000,
+  };
+
+  Port& _port;
+
+  bool     _wip;
+  uint32_t _wait_start_us;
+  uint32_t _wait_typical_us;
+
+  void _start_wait(uint32_t typical_us)
+  {
+    _wip = true;
+    _wait_start_us = micros();
+    _wait_typical_us = typical_us;
+  }
+
+  bool _erase(uint8_t command, uint32_t addr, uint32_t typical_us)
+  {
+    if ( addr >= size() || !_wait_for_flash_ready() ) return false;
+    writeEnable();
+
+    if ( !_port.Port::eraseCommand(command, addr) ) return false;
+    _start_wait(typical_us);
+
+    return true;
+  }
+
+  /// Run task() of an asynchronous operation started on the port until it
+  /// is complete, the longest one it can be is a block erase
+  bool _wait_async(void)
+  {
+    uint32_t const typical_us = 1000UL*device().typical_block_erase_ms;
+    uint32_t const timeout_us = max(typical_us*QSPI_FLASHT_TIMEOUT_FACTOR, (uint32_t) QSPI_FLASHT_TIMEOUT_MIN_US);
+    uint32_t const start_us = micros();
+    uint32_t interval_us = QSPI_FLASHT_POLL_MIN_US;
+
+    _port.task();
+
+    while ( _port.busy() )
+    {
+      if ( (uint32_t) (micros() - start_us) >= timeout_us ) return false;
+
+      uint32_t const poll_us = micros();
+      while ( (uint32_t) (micros() - poll_us) < interval_us ) yield();
+
+      interval_us = min(2*interval_us, (uint32_t) QSPI_FLASHT_TASK_MAX_US);
+      _port.task();
+    }
+
+    return true;
+  }
+
+  /// Sleep through the typical time, then poll with a doubling interval or
+  /// let the peripheral wait if it can. An asynchronous operation started on
+  /// the port is not tracked by _wip, it is completed first.
+  bool _wait_for_flash_ready(void)
+  {
+    if ( _port.busy() && !_wait_async() ) return false;
+    if ( !_wip ) return true;
+
+    uint32_t const typical_us = _wait_typical_us;
+    uint32_t const start_us = typical_us ? _wait_start_us : micros();
+    uint32_t const timeout_us = max(typical_us*QSPI_FLASHT_TIMEOUT_FACTOR, (uint32_t) QSPI_FLASHT_TIMEOUT_MIN_US);
+
+    _wait_typical_us = 0;
+
+    uint32_t elapsed_us = micros() - start_us;
+    if ( elapsed_us + 1000 < typical_us ) delay((typical_us - elapsed_us)/1000);
+    while ( (uint32_t) (micros() - start_us) < typical_us ) yield();
+
+    if ( _port.Port::hasReadyWait() )
+    {
+      elapsed_us = micros() - start_us;
+      if ( elapsed_us >= timeout_us || !_port.Port::waitReady(timeout_us - elapsed_us) ) return false;
+
+      _wip = false;
+      return true;
+    }
+
+    uint32_t const max_interval_us = max(typical_us/4, (uint32_t) QSPI_FLASHT_POLL_MIN_US);
+    uint32_t interval_us = QSPI_FLASHT_POLL_MIN_US;
+
+    while ( readStatus() & 0x03 )
+    {
+      if ( (uint32_t) (micros() - start_us) >= timeout_us ) return false;
+
+      uint32_t const poll_us = micros();
+      while ( (uint32_t) (micros() - poll_us) < interval_us ) yield();
+
+      interval_us = min(2*interval_us, max_interval_us);
+    }
+
+    _wip = false;
+    return true;
+  }
+
+  /// Fastest read/write instructions of the device the port accepts
+  void _set_transfer_modes(void)
+  {
+    if ( !device().supports_qspi ) return;
+
+    if ( device().qpi_read_dummy_cycles && _port.Port::setReadMode(QSPI_XFER_4_4_4, device().qpi_read_dummy_cycles) )
+    {
+      _port.Port::runCommand(QSPI_CMD_ENABLE_QPI);
+      _port.Port::setQPI(true);
+
+      uint8_t const params = ((device().qpi_read_dummy_cycles/2 - 1) & 0x03) << 4;
+      _port.Port::writeCommand(QSPI_CMD_SET_READ_PARAMS, &params, 1);
+
+      _port.Port::setWriteMode(QSPI_XFER_4_4_4);
+      return;
+    }
+
+    if ( device().quad_io_read_dummy_cycles &&
+         _port.Port::setReadMode(QSPI_XFER_1_4_4, device().quad_io_read_dummy_cycles) )
+    {
+      if ( device().continuous_read_mode_bits ) _port.Port::setContinuousReadMode(device().continuous_read_mode_bits);
+    }
+
+    if ( device().supports_quad_io_writes ) _port.Port::setWriteMode(QSPI_XFER_1_4_4);
+  }
+};
+
+#endif /* ADAFRUIT_QSPI_FLASHT_H_ */
@@ -0,0 +1,257 @@
+/**
+ * @file Adafruit_QSPI_SFDP.cpp
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "Adafruit_QSPI.h"
+#include "Adafruit_QSPI_SFDP.h"
+
+enum
+{
+  SFDP_SIGNATURE    = 0x50444653, // "SFDP"
+  SFDP_BFPT_ID      = 0xFF00,
+  SFDP_BFPT_MIN_LEN = 9,          // DWORDs of JESD216 rev 1.0
+  SFDP_BFPT_MAX_LEN = 16,         // DWORDs used by the library
+  SFDP_MAX_HEADERS  = 8,          // parameter headers searched for the BFPT
+};
+
+/// Time field: count in the low bits, unit index above it
+static uint32_t sfdp_time(uint32_t field, uint8_t count_bits, uint32_t const* units)
+{
+  uint32_t const count = field & ((1UL << count_bits) - 1);
+  return (count + 1)*units[field >> count_bits];
+}
+
+static uint32_t sfdp_bits(uint32_t dword, uint8_t lsb, uint8_t width)
+{
+  return (dword >> lsb) & ((1UL << width) - 1);
+}
+
+static bool sfdp_read(uint32_t addr, uint32_t* dwords, uint32_t count)
+{
+  uint8_t buf[4*SFDP_BFPT_MAX_LEN];
+  if ( !QSPI0.readSFDP(addr, buf, 4*count) ) return false;
+
+  // Little endian whatever the MCU is
+  for(uint32_t i=0; i<count; i++)
+  {
+    dwords[i] = buf[4*i] | (buf[4*i+1] << 8) | (buf[4*i+2] << 16) | ((uint32_t) buf[4*i+3] << 24);
+  }
+
+  return true;
+}
+
+bool qspi_sfdp_read_device(external_flash_device* dev, uint8_t const ids[3])
+{
+  uint32_t header[2];
+  if ( !sfdp_read(0, header, 2) || header[0] != SFDP_SIGNATURE ) return false;
+
+  // Major revision 1 only, parameter headers follow the SFDP header
+  if ( sfdp_bits(header[1], 8, 8) != 1 ) return false;
+  uint32_t const nph = sfdp_bits(header[1], 16, 8) + 1;
+
+  uint32_t bfpt_addr = 0, bfpt_len = 0;
+  for(uint32_t i=0; i<nph && i<SFDP_MAX_HEADERS; i++)
+  {
+    uint32_t param[2];
+    if ( !sfdp_read(8 + 8*i, param, 2) ) return false;
+
+    uint32_t const id = (sfdp_bits(param[1], 24, 8) << 8) | sfdp_bits(param[0], 0, 8);
+    if ( id != SFDP_BFPT_ID ) continue;
+
+    // Later BFPT headers describe newer revisions of the table
+    bfpt_addr = param[1] & 0xffffff;
+    bfpt_len  = sfdp_bits(param[0], 24, 8);
+  }
+
+  if ( bfpt_len < SFDP_BFPT_MIN_LEN ) return false;
+  if ( bfpt_len > SFDP_BFPT_MAX_LEN ) bfpt_len = SFDP_BFPT_MAX_LEN;
+
+  // dw[n] is the n-th DWORD of the BFPT, as numbered by JESD216
+  uint32_t dw[SFDP_BFPT_MAX_LEN+1];
+  memset(dw, 0, sizeof(dw));
+  if ( !sfdp_read(bfpt_addr, dw+1, bfpt_len) ) return false;
+
+  memset(dev, 0, sizeof(external_flash_device));
+  dev->manufacturer_id = ids[0];
+  dev->memory_type     = ids[1];
+  dev->capacity        = ids[2];
+  dev->start_up_time_us = 10000;
+  dev->max_clock_speed_mhz = QSPI_SFDP_CLOCK_MHZ;
+  dev->supports_fast_read = true;
+
+  //------------- Density -------------//
+  // Size in bits: N+1, or 2^N when bit 31 is set. Up to 2GiB.
+  uint64_t bits = (uint64_t) dw[2] + 1;
+  if ( dw[2] & 0x80000000UL )
+  {
+    uint32_t const n = dw[2] & 0x7fffffffUL;
+    if ( n > 34 ) return false;
+    bits = 1ULL << n;
+  }
+  dev->total_size = (uint32_t) (bits/8);
+
+  // Memory beyond 16MiB needs Enable 4-Byte Address Mode 0xB7 without Write Enable
+  if ( dev->total_size > (1UL << 24) )
+  {
+    bool const b7 = (sfdp_bits(dw[1], 17, 2) != 0) && (bfpt_len >= 16) && (sfdp_bits(dw[16], 24, 8) & 0x01);
+    if ( !b7 ) dev->total_size = 1UL << 24;
+  }
+
+  //------------- Erase types (size 2^N, opcode) -------------//
+  static uint32_t const erase_units[] = { 1, 16, 128, 1000 }; // ms
+  bool has_sector = false, has_block = false;
+
+  for(uint8_t i=0; i<4; i++)
+  {
+    uint32_t const type   = sfdp_bits(dw[8 + i/2], 16*(i%2), 16);
+    uint32_t const shift  = type & 0xff;
+    uint32_t const opcode = type >> 8;
+    uint32_t const ms     = (bfpt_len >= 10) ? sfdp_time(sfdp_bits(dw[10], 4 + 7*i, 7), 5, erase_units) : 0;
+
+    if ( shift == 12 && opcode == QSPI_CMD_ERASE_SECTOR )
+    {
+      has_sector = true;
+      dev->typical_sector_erase_ms = ms ? ms : 400;
+    }
+    else if ( shift == 15 && opcode == QSPI_CMD_ERASE_BLOCK32 )
+    {
+      dev->typical_block32_erase_ms = ms ? ms : 1600;
+    }
+    else if ( shift == 16 && opcode == QSPI_CMD_ERASE_BLOCK )
+    {
+      has_block = true;
+      dev->typical_block_erase_ms = ms ? ms : 2000;
+    }
+  }
+
+  // 4KiB erase may only be in the first DWORD of early tables
+  if ( !has_sector && sfdp_bits(dw[1], 0, 2) == 0x01 && sfdp_bits(dw[1], 8, 8) == QSPI_CMD_ERASE_SECTOR )
+  {
+    has_sector = true;
+    dev->typical_sector_erase_ms = 400;
+  }
+
+  if ( !has_sector || !has_block ) return false;
+
+  //------------- Page program and chip erase times -------------//
+  if ( bfpt_len >= 11 )
+  {
+    static uint32_t const program_units[] = { 8, 64 };           // us
+    static uint32_t const chip_units[]    = { 16, 256, 4000, 64000 }; // ms
+
+    if ( sfdp_bits(dw[11], 4, 4) != 8 ) return false; // 256-byte pages
+
+    dev->typical_page_program_us = sfdp_time(sfdp_bits(dw[11], 8, 6), 5, program_units);
+    dev->typical_chip_erase_ms   = sfdp_time(sfdp_bits(dw[11], 24, 7), 5, chip_units);
+  }else
+  {
+    dev->typical_page_program_us = 3000;
+    dev->typical_chip_erase_ms   = 200000;
+  }
+
+  //------------- Quad enable -------------//
+  // Without the 15th DWORD the QE bit is unknown, quad modes stay disabled
+  bool quad = false;
+  if ( bfpt_len >= 15 )
+  {
+    switch ( sfdp_bits(dw[15], 20, 3) )
+    {
+      case 0: // no QE bit, IO2/IO3 are always data lines
+        quad = true;
+      break;
+
+      case 2: // bit 6 of the single status register
+        dev->quad_enable_bit_mask = 0x40;
+        dev->single_status_byte = true;
+        quad = true;
+      break;
+
+      case 1: case 4: case 5: // bit 1 of status register 2, written with 0x01
+        dev->quad_enable_bit_mask = 0x02;
+        quad = true;
+      break;
+
+      case 6: // bit 1 of status register 2, written with 0x31
+        dev->quad_enable_bit_mask = 0x02;
+        dev->write_status_register_split = true;
+        quad = true;
+      break;
+
+      default: break; // bit 7 of status register 2 through 0x3E/0x3F
+    }
+  }
+
+  //------------- Quad read modes -------------//
+  if ( quad )
+  {
+    // 1-1-4 0x6B with 8 wait states, mode clocks included
+    uint32_t const read114 = sfdp_bits(dw[3], 16, 16);
+    if ( (dw[1] & (1UL << 22)) && (read114 >> 8) == QSPI_CMD_QUAD_READ &&
+         sfdp_bits(read114, 0, 5) + sfdp_bits(read114, 5, 3) == 8 )
+    {
+      // Quad page program 0x32 is not in the BFPT, parts with 0x6B have it
+      dev->supports_qspi = true;
+      dev->supports_qspi_writes = true;
+    }
+
+    // 1-4-4 0xEB: the ports send 2 mode clocks followed by the dummy ones
+    uint32_t const read144 = sfdp_bits(dw[3], 0, 16);
+    uint32_t const mode144 = sfdp_bits(read144, 5, 3);
+    uint32_t const wait144 = sfdp_bits(read144, 0, 5) + mode144;
+    if ( dev->supports_qspi && (dw[1] & (1UL << 21)) && (read144 >> 8) == QSPI_CMD_QUAD_IO_READ && wait144 >= 2 )
+    {
+      dev->quad_io_read_dummy_cycles = wait144 - 2;
+
+      // 0-4-4 mode: entered with mode bits A5h or Axh
+      if ( mode144 == 2 && bfpt_len >= 15 && (dw[15] & (1UL << 9)) )
+      {
+        uint32_t const entry = sfdp_bits(dw[15], 16, 4);
+        if ( entry & 0x01 ) dev->continuous_read_mode_bits = 0xa5;
+        else if ( entry & 0x04 ) dev->continuous_read_mode_bits = 0xa0;
+      }
+    }
+
+    // 0x38 is the 1-4-4 page program on Macronix parts but Enable QPI on
+    // others, SFDP does not tell them apart
+    dev->supports_quad_io_writes = dev->quad_io_read_dummy_cycles && (ids[0] == 0xc2);
+  }
+
+  // QPI dummy cycles are set with 0xC0 on some parts only, that is not
+  // described by SFDP: qpi_read_dummy_cycles stays 0.
+
+  //------------- Erase suspend/resume -------------//
+  // 0x75/0x7A only, suspend latency in 128ns/1us/8us/64us units
+  if ( bfpt_len >= 13 && !(dw[12] & 0x80000000UL) &&
+       sfdp_bits(dw[13], 24, 8) == QSPI_CMD_ERASE_SUSPEND && sfdp_bits(dw[13], 16, 8) == QSPI_CMD_ERASE_RESUME )
+  {
+    static uint32_t const suspend_units[] = { 128, 1000, 8000, 64000 }; // ns
+    uint32_t const us = (sfdp_time(sfdp_bits(dw[12], 24, 7), 5, suspend_units) + 999)/1000;
+
+    dev->erase_suspend_us = (us > 255) ? 255 : us;
+  }
+
+  return true;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file Adafruit_QSPI_SFDP.h
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ADAFRUIT_QSPI_SFDP_H_
+#define ADAFRUIT_QSPI_SFDP_H_
+
+#include <stdint.h>
+#include "external_flash_device.h"
+
+/**
+ * Describe the flash from its Serial Flash Discoverable Parameters (JESD216)
+ * Basic Flash Parameter Table: size, erase types and times, quad enable
+ * method, quad read modes, erase suspend and 4-byte addressing. SFDP has no
+ * clock speed, the ports cap QSPI_SFDP_CLOCK_MHZ to their own maximum.
+ * Features the library can only drive with other opcodes than the ones it
+ * uses (e.g quad enable through 0x3E, erase suspend 0xB0) are left disabled.
+ * @param dev  filled with the description, JEDEC ID included
+ * @param ids  JEDEC ID of the flash
+ * @return true if the flash has a table the library can use
+ */
+bool qspi_sfdp_read_device(external_flash_device* dev, uint8_t const ids[3]);
+
+/// Clock speed of flash devices described by SFDP
+#define QSPI_SFDP_CLOCK_MHZ   80
+
+#endif /* ADAFRUIT_QSPI_SFDP_H_ */
@@ -0,0 +1,60 @@
+/**
+ * @file Adafruit_QSPI_Stats.cpp
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "Adafruit_QSPI_Stats.h"
+
+#if ADAFRUIT_QSPI_STATS
+
+qspi_stats_t qspi_stats_data;
+
+void qspi_stats_reset(void)
+{
+  memset(&qspi_stats_data, 0, sizeof(qspi_stats_data));
+}
+
+/**
+ * Account an operation that started at start_us. Latencies are taken with
+ * micros(): the DWT cycle counter would wrap during long erases.
+ * @param op        QSPI_STATS_READ, QSPI_STATS_PROGRAM, QSPI_STATS_ERASE or QSPI_STATS_WAIT
+ * @param bytes     bytes moved or erased
+ * @param start_us  qspi_stats_start() taken before the operation
+ */
+void qspi_stats_record(uint8_t op, uint32_t bytes, uint32_t start_us)
+{
+  uint32_t const us = micros() - start_us;
+
+  // Bucket is the number of significant bits of the latency
+  uint32_t bucket = us ? 32 - __builtin_clz(us) : 0;
+  if ( bucket >= QSPI_STATS_BUCKETS ) bucket = QSPI_STATS_BUCKETS - 1;
+
+  qspi_stats_data.count[op]++;
+  qspi_stats_data.bytes[op] += bytes;
+  qspi_stats_data.total_us[op] += us;
+  if ( us > qspi_stats_data.max_us[op] ) qspi_stats_data.max_us[op] = us;
+  qspi_stats_data.histogram[op][bucket]++;
+}
+
+#endif
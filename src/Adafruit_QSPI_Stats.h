@@ -0,0 +1,99 @@
+/**
+ * @file Adafruit_QSPI_Stats.h
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ADAFRUIT_QSPI_STATS_H_
+#define ADAFRUIT_QSPI_STATS_H_
+
+#include <Arduino.h>
+
+// Counters and latency histograms of flash operations, e.g to tell whether a
+// slow write spends its time on the bus, erasing or polling the status.
+// Build with -DADAFRUIT_QSPI_STATS=1 to enable, otherwise all hooks below are
+// empty inline functions and compile to nothing.
+#ifndef ADAFRUIT_QSPI_STATS
+#define ADAFRUIT_QSPI_STATS   0
+#endif
+
+/// Timed operations
+enum
+{
+  QSPI_STATS_READ = 0,  ///< memory read transfer
+  QSPI_STATS_PROGRAM,   ///< page program transfer, program time itself is in QSPI_STATS_WAIT
+  QSPI_STATS_ERASE,     ///< erase command, erase time itself is in QSPI_STATS_WAIT
+  QSPI_STATS_WAIT,      ///< wait for a program/erase to complete
+  QSPI_STATS_OP_COUNT
+};
+
+/// Event counters
+enum
+{
+  QSPI_STATS_STATUS_POLL = 0, ///< Read Status sent
+  QSPI_STATS_CACHE_FLUSH,     ///< CPU cache invalidated by the port (SAMD51 CMCC)
+  QSPI_STATS_ERASE_SUSPEND,   ///< erase suspended to serve a read
+  QSPI_STATS_EVENT_COUNT
+};
+
+/// Histogram bucket n counts latencies below 2^n microseconds (and at least
+/// 2^(n-1)), the last bucket all longer ones
+enum
+{
+  QSPI_STATS_BUCKETS = 24,
+};
+
+typedef struct
+{
+  uint32_t count[QSPI_STATS_OP_COUNT];       ///< number of operations
+  uint32_t bytes[QSPI_STATS_OP_COUNT];       ///< bytes read, programmed or erased
+  uint64_t total_us[QSPI_STATS_OP_COUNT];    ///< sum of latencies
+  uint32_t max_us[QSPI_STATS_OP_COUNT];      ///< longest latency
+  uint32_t histogram[QSPI_STATS_OP_COUNT][QSPI_STATS_BUCKETS];
+  uint32_t events[QSPI_STATS_EVENT_COUNT];
+} qspi_stats_t;
+
+#if ADAFRUIT_QSPI_STATS
+
+extern qspi_stats_t qspi_stats_data;
+
+/// @return statistics since the last reset
+static inline qspi_stats_t const* qspi_stats(void) { return &qspi_stats_data; }
+
+/// Clear all counters and histograms
+void qspi_stats_reset(void);
+
+void qspi_stats_record(uint8_t op, uint32_t bytes, uint32_t start_us);
+
+static inline uint32_t qspi_stats_start(void) { return micros(); }
+static inline void qspi_stats_event(uint8_t event) { qspi_stats_data.events[event]++; }
+
+#else
+
+static inline uint32_t qspi_stats_start(void) { return 0; }
+static inline void qspi_stats_record(uint8_t op, uint32_t bytes, uint32_t start_us) { (void) op; (void) bytes; (void) start_us; }
+static inline void qspi_stats_event(uint8_t event) { (void) event; }
+
+#endif
+
+#endif /* ADAFRUIT_QSPI_STATS_H_ */
@@ -0,0 +1,103 @@
+/**
+ * @file Adafruit_QSPI_Trace.cpp
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "Adafruit_QSPI_Trace.h"
+
+#if ADAFRUIT_QSPI_TRACE
+
+static qspi_trace_entry_t _entries[ADAFRUIT_QSPI_TRACE_DEPTH];
+static uint32_t _head;    // next slot to fill
+static uint32_t _count;
+static uint32_t _dropped;
+static uint8_t  _depth;   // nesting of traced operations
+
+void qspi_trace_reset(void)
+{
+  _head = _count = _dropped = 0;
+}
+
+uint32_t qspi_trace_count(void)
+{
+  return _count;
+}
+
+/**
+ * Claim the next slot for an operation, overwriting the oldest entry when
+ * the ring is full.
+ * @return slot index, or -1 if nested in another traced operation
+ */
+int32_t qspi_trace_begin(uint8_t type, uint8_t opcode, uint32_t addr, uint32_t len)
+{
+  if ( _depth++ ) return -1;
+
+  uint32_t const slot = _head;
+  qspi_trace_entry_t* entry = &_entries[slot];
+
+  entry->type     = type;
+  entry->opcode   = opcode;
+  entry->reserved = 0;
+  entry->addr     = addr;
+  entry->len      = len;
+  entry->start_us = micros();
+  entry->end_us   = entry->start_us;
+
+  _head = (_head + 1) % ADAFRUIT_QSPI_TRACE_DEPTH;
+  if ( _count < ADAFRUIT_QSPI_TRACE_DEPTH ) _count++;
+  else _dropped++;
+
+  return (int32_t) slot;
+}
+
+void qspi_trace_end(int32_t slot)
+{
+  _depth--;
+  if ( slot >= 0 ) _entries[slot].end_us = micros();
+}
+
+uint32_t qspi_trace_dump(qspi_trace_write_t write, void* arg)
+{
+  qspi_trace_header_t const header =
+  {
+    .magic      = QSPI_TRACE_MAGIC,
+    .version    = QSPI_TRACE_VERSION,
+    .entry_size = sizeof(qspi_trace_entry_t),
+    .count      = _count,
+    .dropped    = _dropped,
+  };
+
+  write((uint8_t const*) &header, sizeof(header), arg);
+
+  // Oldest entry first: at most two contiguous runs of the ring
+  uint32_t const first = (_head + ADAFRUIT_QSPI_TRACE_DEPTH - _count) % ADAFRUIT_QSPI_TRACE_DEPTH;
+  uint32_t const run   = min(_count, (uint32_t) (ADAFRUIT_QSPI_TRACE_DEPTH - first));
+
+  write((uint8_t const*) &_entries[first], run*sizeof(qspi_trace_entry_t), arg);
+  if ( run < _count ) write((uint8_t const*) &_entries[0], (_count - run)*sizeof(qspi_trace_entry_t), arg);
+
+  return _count;
+}
+
+#endif
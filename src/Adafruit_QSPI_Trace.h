@@ -0,0 +1,157 @@
+/**
+ * @file Adafruit_QSPI_Trace.h
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ADAFRUIT_QSPI_TRACE_H_
+#define ADAFRUIT_QSPI_TRACE_H_
+
+#include <Arduino.h>
+
+// Ring buffer of the last port operations, to capture the access pattern of
+// a workload in the field and replay it on a host (see extras/host).
+// Build with -DADAFRUIT_QSPI_TRACE=1 to enable, otherwise qspi_trace_scope
+// below is an empty class and compiles to nothing.
+#ifndef ADAFRUIT_QSPI_TRACE
+#define ADAFRUIT_QSPI_TRACE   0
+#endif
+
+// Number of entries kept, older ones are overwritten
+#ifndef ADAFRUIT_QSPI_TRACE_DEPTH
+#define ADAFRUIT_QSPI_TRACE_DEPTH   256
+#endif
+
+/// Traced port operations
+enum
+{
+  QSPI_TRACE_RUN_COMMAND = 0, ///< runCommand()
+  QSPI_TRACE_READ_COMMAND,    ///< readCommand()
+  QSPI_TRACE_WRITE_COMMAND,   ///< writeCommand(), addr holds the first 4 data bytes
+  QSPI_TRACE_ERASE_COMMAND,   ///< eraseCommand()
+  QSPI_TRACE_READ_MEMORY,     ///< readMemory(), opcode is 0
+  QSPI_TRACE_WRITE_MEMORY,    ///< writeMemory(), opcode is 0
+  QSPI_TRACE_CONFIG,          ///< port setting accepted, opcode is QSPI_TRACE_SET_xxx
+  QSPI_TRACE_TYPE_COUNT
+};
+
+/// Port settings of QSPI_TRACE_CONFIG entries, so that a replay runs with the
+/// same clock and transfer modes
+enum
+{
+  QSPI_TRACE_SET_CLOCK = 0,       ///< addr is the resulting SCK frequency in Hz
+  QSPI_TRACE_SET_READ_MODE,       ///< setReadMode(addr, len)
+  QSPI_TRACE_SET_WRITE_MODE,      ///< setWriteMode(addr)
+  QSPI_TRACE_SET_QPI,             ///< setQPI(addr)
+  QSPI_TRACE_SET_ADDRESS_LENGTH,  ///< setAddressLength(addr)
+  QSPI_TRACE_SET_CONTINUOUS_READ, ///< setContinuousReadMode(addr)
+};
+
+/// Dump format: a qspi_trace_header_t followed by count entries oldest
+/// first, all fields little endian
+enum
+{
+  QSPI_TRACE_MAGIC   = 0x43525451, ///< "QTRC"
+  QSPI_TRACE_VERSION = 1,
+};
+
+typedef struct
+{
+  uint32_t magic;      ///< QSPI_TRACE_MAGIC
+  uint16_t version;    ///< QSPI_TRACE_VERSION
+  uint16_t entry_size; ///< sizeof(qspi_trace_entry_t)
+  uint32_t count;      ///< number of entries that follow
+  uint32_t dropped;    ///< older entries overwritten before the dump
+} qspi_trace_header_t;
+
+typedef struct
+{
+  uint8_t  type;       ///< QSPI_TRACE_RUN_COMMAND ... QSPI_TRACE_WRITE_MEMORY
+  uint8_t  opcode;     ///< command opcode
+  uint16_t reserved;
+  uint32_t addr;       ///< flash address
+  uint32_t len;        ///< data length in bytes
+  uint32_t start_us;   ///< micros() when the operation was issued
+  uint32_t end_us;     ///< micros() when it returned
+} qspi_trace_entry_t;
+
+/// Output of qspi_trace_dump(), e.g a wrapper around Serial.write()
+typedef void (*qspi_trace_write_t)(uint8_t const* data, uint32_t len, void* arg);
+
+#if ADAFRUIT_QSPI_TRACE
+
+/// Discard all entries
+void qspi_trace_reset(void);
+
+/// @return number of entries currently held
+uint32_t qspi_trace_count(void);
+
+/// Write header and entries in the dump format
+/// @param write  output function, called once per chunk
+/// @param arg    passed to write
+/// @return number of entries written
+uint32_t qspi_trace_dump(qspi_trace_write_t write, void* arg);
+
+int32_t qspi_trace_begin(uint8_t type, uint8_t opcode, uint32_t addr, uint32_t len);
+void qspi_trace_end(int32_t slot);
+
+/// Record a port setting, called by ports once it is applied
+static inline void qspi_trace_config(uint8_t setting, uint32_t value, uint32_t extra)
+{
+  qspi_trace_end(qspi_trace_begin(QSPI_TRACE_CONFIG, setting, value, extra));
+}
+
+/// Records the port operation it lives in, from construction to the return.
+/// Operations issued by another traced one (e.g nRF 32KiB erase through
+/// writeCommand) are not recorded on their own.
+class qspi_trace_scope
+{
+  public:
+    qspi_trace_scope(uint8_t type, uint8_t opcode, uint32_t addr, uint32_t len) { _slot = qspi_trace_begin(type, opcode, addr, len); }
+    ~qspi_trace_scope() { qspi_trace_end(_slot); }
+
+  private:
+    int32_t _slot;
+};
+
+#else
+
+static inline void qspi_trace_config(uint8_t setting, uint32_t value, uint32_t extra) { (void) setting; (void) value; (void) extra; }
+
+class qspi_trace_scope
+{
+  public:
+    qspi_trace_scope(uint8_t type, uint8_t opcode, uint32_t addr, uint32_t len) { (void) type; (void) opcode; (void) addr; (void) len; }
+};
+
+#endif
+
+/// addr field of a QSPI_TRACE_WRITE_COMMAND entry
+static inline uint32_t qspi_trace_command_data(uint8_t const* data, uint32_t len)
+{
+  uint32_t value = 0;
+  for ( uint32_t i = 0; data && i < len && i < 4; i++ ) value |= ((uint32_t) data[i]) << (8*i);
+  return value;
+}
+
+#endif /* ADAFRUIT_QSPI_TRACE_H_ */
@@ -64,6 +64,39 @@ typedef struct {
     // True when the status register is a single byte. This implies the Quad Enable bit is in the
     // first byte and the Read Status Register 2 command (0x35) is unsupported.
     bool single_status_byte: 1;
+
+    // Typical (not maximum) page program, 4KiB sector erase, 64KiB block erase and chip erase
+    // times from the datasheet. The driver sleeps for this long before polling status and gives
+    // up after 16 times as long, so values that are too high slow writes down and values that are
+    // too low cause timeouts on the device. The host port also uses them to model the device.
+    uint16_t typical_page_program_us;
+    uint16_t typical_sector_erase_ms;
+    uint16_t typical_block_erase_ms;
+    uint32_t typical_chip_erase_ms;
+
+    // Mode byte sent after the address of Fast Read Quad I/O 0xEB (2 mode clocks followed by 4
+    // dummy clocks) that keeps the device in continuous read mode, so that following reads skip
+    // the opcode. 0x00 if not supported.
+    uint8_t continuous_read_mode_bits;
+
+    // Dummy clocks that follow the 2 mode clocks of Fast Read Quad I/O 0xEB, which also sends
+    // the address on four lines (1-4-4). 0x00 if not supported.
+    uint8_t quad_io_read_dummy_cycles;
+
+    // Supports the quad input page program command 0x38 that also sends the address on four
+    // lines (1-4-4). Not to be confused with 0x38 Enable QPI of Winbond and GigaDevice parts.
+    bool supports_quad_io_writes: 1;
+
+    // Dummy clocks of Fast Read 0x0B in QPI mode (4-4-4), entered with 0x38 and configured with
+    // Set Read Parameters 0xC0. 0x00 if QPI is not supported or not to be used.
+    uint8_t qpi_read_dummy_cycles;
+
+    // Typical 32KiB block erase 0x52 time from the datasheet. 0 if not supported.
+    uint16_t typical_block32_erase_ms;
+
+    // Maximum time from Erase Suspend 0x75 until the device accepts reads (tSUS). 0x00 if Erase
+    // Suspend 0x75 / Resume 0x7A are not supported.
+    uint8_t erase_suspend_us;
 } external_flash_device;
 
 // Settings for the Adesto Tech AT25DF081A 1MiB SPI flash. Its on the SAMD21
@@ -83,6 +116,16 @@ typedef struct {
     .supports_qspi_writes = false, \
     .write_status_register_split = false, \
     .single_status_byte = false, \
+    .typical_page_program_us = 1000, \
+    .typical_sector_erase_ms = 50, \
+    .typical_block_erase_ms = 400, \
+    .typical_chip_erase_ms = 9000, \
+    .continuous_read_mode_bits = 0x00, \
+    .quad_io_read_dummy_cycles = 0, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 250, \
+    .erase_suspend_us = 0, \
 }
 
 // Settings for the Gigadevice GD25Q16C 2MiB SPI flash.
@@ -101,6 +144,16 @@ typedef struct {
     .supports_qspi_writes = true, \
     .write_status_register_split = false, \
     .single_status_byte = false, \
+    .typical_page_program_us = 600, \
+    .typical_sector_erase_ms = 50, \
+    .typical_block_erase_ms = 250, \
+    .typical_chip_erase_ms = 6000, \
+    .continuous_read_mode_bits = 0xa0, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 150, \
+    .erase_suspend_us = 20, \
 }
 
 // Settings for the Gigadevice GD25Q64C 8MiB SPI flash.
@@ -119,6 +172,16 @@ typedef struct {
     .supports_qspi_writes = true, \
     .write_status_register_split = true, \
     .single_status_byte = false, \
+    .typical_page_program_us = 600, \
+    .typical_sector_erase_ms = 50, \
+    .typical_block_erase_ms = 250, \
+    .typical_chip_erase_ms = 25000, \
+    .continuous_read_mode_bits = 0xa0, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 150, \
+    .erase_suspend_us = 20, \
 }
 
 // Settings for the Cypress (was Spansion) S25FL064L 8MiB SPI flash.
@@ -137,6 +200,16 @@ typedef struct {
     .supports_qspi_writes = true, \
     .write_status_register_split = false, \
     .single_status_byte = false, \
+    .typical_page_program_us = 450, \
+    .typical_sector_erase_ms = 50, \
+    .typical_block_erase_ms = 320, \
+    .typical_chip_erase_ms = 33000, \
+    .continuous_read_mode_bits = 0x00, \
+    .quad_io_read_dummy_cycles = 0, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 150, \
+    .erase_suspend_us = 40, \
 }
 
 // Settings for the Cypress (was Spansion) S25FL116K 2MiB SPI flash.
@@ -155,6 +228,16 @@ typedef struct {
     .supports_qspi_writes = false, \
     .write_status_register_split = false, \
     .single_status_byte = false, \
+    .typical_page_program_us = 700, \
+    .typical_sector_erase_ms = 50, \
+    .typical_block_erase_ms = 500, \
+    .typical_chip_erase_ms = 7000, \
+    .continuous_read_mode_bits = 0xa0, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 0, \
+    .erase_suspend_us = 20, \
 }
 
 // Settings for the Cypress (was Spansion) S25FL216K 2MiB SPI flash.
@@ -173,6 +256,16 @@ typedef struct {
     .supports_qspi_writes = false, \
     .write_status_register_split = false, \
     .single_status_byte = false, \
+    .typical_page_program_us = 700, \
+    .typical_sector_erase_ms = 50, \
+    .typical_block_erase_ms = 500, \
+    .typical_chip_erase_ms = 7000, \
+    .continuous_read_mode_bits = 0x00, \
+    .quad_io_read_dummy_cycles = 0, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 0, \
+    .erase_suspend_us = 0, \
 }
 
 // Settings for the Winbond W25Q16FW 2MiB SPI flash.
@@ -191,6 +284,16 @@ typedef struct {
     .supports_qspi_writes = true, \
     .write_status_register_split = false, \
     .single_status_byte = false, \
+    .typical_page_program_us = 400, \
+    .typical_sector_erase_ms = 45, \
+    .typical_block_erase_ms = 150, \
+    .typical_chip_erase_ms = 5000, \
+    .continuous_read_mode_bits = 0xa0, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 8, \
+    .typical_block32_erase_ms = 120, \
+    .erase_suspend_us = 20, \
 }
 
 // Settings for the Winbond W25Q16JV-IQ 2MiB SPI flash. Note that JV-IM has a different .memory_type (0x70)
@@ -209,6 +312,16 @@ typedef struct {
     .supports_qspi_writes = true, \
     .write_status_register_split = false, \
     .single_status_byte = false, \
+    .typical_page_program_us = 400, \
+    .typical_sector_erase_ms = 45, \
+    .typical_block_erase_ms = 150, \
+    .typical_chip_erase_ms = 5000, \
+    .continuous_read_mode_bits = 0xa0, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 120, \
+    .erase_suspend_us = 20, \
 }
 
 // Settings for the Winbond W25Q16JV-IM 2MiB SPI flash. Note that JV-IQ has a different .memory_type (0x40)
@@ -226,6 +339,17 @@ typedef struct {
     .supports_qspi = true, \
     .supports_qspi_writes = true, \
     .write_status_register_split = false, \
+    .single_status_byte = false, \
+    .typical_page_program_us = 400, \
+    .typical_sector_erase_ms = 45, \
+    .typical_block_erase_ms = 150, \
+    .typical_chip_erase_ms = 5000, \
+    .continuous_read_mode_bits = 0xa0, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 120, \
+    .erase_suspend_us = 20, \
 }
 
 // Settings for the Winbond W25Q32BV 4MiB SPI flash.
@@ -244,6 +368,16 @@ typedef struct {
     .supports_qspi_writes = false, \
     .write_status_register_split = false, \
     .single_status_byte = false, \
+    .typical_page_program_us = 700, \
+    .typical_sector_erase_ms = 30, \
+    .typical_block_erase_ms = 150, \
+    .typical_chip_erase_ms = 10000, \
+    .continuous_read_mode_bits = 0xa0, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 120, \
+    .erase_suspend_us = 20, \
 }
 // Settings for the Winbond W25Q32JV-IM 4MiB SPI flash.
 // Datasheet: https://www.winbond.com/resource-files/w25q32jv%20revg%2003272018%20plus.pdf
@@ -260,6 +394,17 @@ typedef struct {
     .supports_qspi = true, \
     .supports_qspi_writes = true, \
     .write_status_register_split = false, \
+    .single_status_byte = false, \
+    .typical_page_program_us = 400, \
+    .typical_sector_erase_ms = 45, \
+    .typical_block_erase_ms = 150, \
+    .typical_chip_erase_ms = 10000, \
+    .continuous_read_mode_bits = 0xa0, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 120, \
+    .erase_suspend_us = 20, \
 }
 
 // Settings for the Winbond W25Q64JV-IM 8MiB SPI flash. Note that JV-IQ has a different .memory_type (0x40)
@@ -278,6 +423,16 @@ typedef struct {
     .supports_qspi_writes = true, \
     .write_status_register_split = false, \
     .single_status_byte = false, \
+    .typical_page_program_us = 400, \
+    .typical_sector_erase_ms = 45, \
+    .typical_block_erase_ms = 150, \
+    .typical_chip_erase_ms = 20000, \
+    .continuous_read_mode_bits = 0xa0, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 120, \
+    .erase_suspend_us = 20, \
 }
 
 // Settings for the Winbond W25Q64JV-IQ 8MiB SPI flash. Note that JV-IM has a different .memory_type (0x70)
@@ -296,6 +451,16 @@ typedef struct {
     .supports_qspi_writes = true, \
     .write_status_register_split = false, \
     .single_status_byte = false, \
+    .typical_page_program_us = 400, \
+    .typical_sector_erase_ms = 45, \
+    .typical_block_erase_ms = 150, \
+    .typical_chip_erase_ms = 20000, \
+    .continuous_read_mode_bits = 0xa0, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 120, \
+    .erase_suspend_us = 20, \
 }
 
 // Settings for the Winbond W25Q80DL 1MiB SPI flash.
@@ -314,6 +479,16 @@ typedef struct {
     .supports_qspi_writes = false, \
     .write_status_register_split = false, \
     .single_status_byte = false, \
+    .typical_page_program_us = 800, \
+    .typical_sector_erase_ms = 60, \
+    .typical_block_erase_ms = 450, \
+    .typical_chip_erase_ms = 3000, \
+    .continuous_read_mode_bits = 0xa0, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 120, \
+    .erase_suspend_us = 20, \
 }
 
 
@@ -333,6 +508,45 @@ typedef struct {
     .supports_qspi_writes = true, \
     .write_status_register_split = false, \
     .single_status_byte = false, \
+    .typical_page_program_us = 400, \
+    .typical_sector_erase_ms = 45, \
+    .typical_block_erase_ms = 150, \
+    .typical_chip_erase_ms = 40000, \
+    .continuous_read_mode_bits = 0xa0, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 120, \
+    .erase_suspend_us = 20, \
+}
+
+// Settings for the Winbond W25Q256JV-IQ 32MiB SPI flash. Memory beyond 16MiB needs 4-byte
+// addresses, see Enable 4-Byte Address Mode 0xB7.
+// Datasheet: https://www.winbond.com/resource-files/w25q256jv%20spi%20revg%2008032017.pdf
+#define W25Q256JV_IQ {\
+    .total_size = (1 << 25), /* 32 MiB */ \
+    .start_up_time_us = 5000, \
+    .manufacturer_id = 0xef, \
+    .memory_type = 0x40, \
+    .capacity = 0x19, \
+    .max_clock_speed_mhz = 133, \
+    .quad_enable_bit_mask = 0x02, \
+    .has_sector_protection = false, \
+    .supports_fast_read = true, \
+    .supports_qspi = true, \
+    .supports_qspi_writes = true, \
+    .write_status_register_split = false, \
+    .single_status_byte = false, \
+    .typical_page_program_us = 400, \
+    .typical_sector_erase_ms = 50, \
+    .typical_block_erase_ms = 150, \
+    .typical_chip_erase_ms = 80000, \
+    .continuous_read_mode_bits = 0xa0, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 120, \
+    .erase_suspend_us = 20, \
 }
 
 // Settings for the Macronix MX25L1606 2MiB SPI flash.
@@ -351,6 +565,16 @@ typedef struct {
     .supports_qspi_writes = true, \
     .write_status_register_split = false, \
     .single_status_byte = true, \
+    .typical_page_program_us = 1400, \
+    .typical_sector_erase_ms = 40, \
+    .typical_block_erase_ms = 700, \
+    .typical_chip_erase_ms = 14000, \
+    .continuous_read_mode_bits = 0xa5, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = true, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 250, \
+    .erase_suspend_us = 0, \
 }
 
 // Settings for the Macronix MX25L3233F 4MiB SPI flash.
@@ -369,6 +593,16 @@ typedef struct {
     .supports_qspi_writes = true, \
     .write_status_register_split = false, \
     .single_status_byte = true, \
+    .typical_page_program_us = 500, \
+    .typical_sector_erase_ms = 25, \
+    .typical_block_erase_ms = 220, \
+    .typical_chip_erase_ms = 12000, \
+    .continuous_read_mode_bits = 0xa5, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = true, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 140, \
+    .erase_suspend_us = 20, \
 }
 
 // Settings for the Macronix MX25R6435F 8MiB SPI flash.
@@ -388,6 +622,16 @@ typedef struct {
     .supports_qspi_writes = true, \
     .write_status_register_split = false, \
     .single_status_byte = true, \
+    .typical_page_program_us = 850, \
+    .typical_sector_erase_ms = 40, \
+    .typical_block_erase_ms = 400, \
+    .typical_chip_erase_ms = 50000, \
+    .continuous_read_mode_bits = 0xa5, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = true, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 240, \
+    .erase_suspend_us = 20, \
 }
 
 // Settings for the Winbond W25Q128JV-PM 16MiB SPI flash. Note that JV-IM has a different .memory_type (0x70)
@@ -405,6 +649,17 @@ typedef struct {
     .supports_qspi = true, \
     .supports_qspi_writes = true, \
     .write_status_register_split = false, \
+    .single_status_byte = false, \
+    .typical_page_program_us = 400, \
+    .typical_sector_erase_ms = 45, \
+    .typical_block_erase_ms = 150, \
+    .typical_chip_erase_ms = 40000, \
+    .continuous_read_mode_bits = 0xa0, \
+    .quad_io_read_dummy_cycles = 4, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 120, \
+    .erase_suspend_us = 20, \
 }
 
 // Settings for the Winbond W25Q32FV 4MiB SPI flash.
@@ -423,5 +678,15 @@ typedef struct {
     .supports_qspi_writes = false, \
     .write_status_register_split = false, \
     .single_status_byte = false, \
+    .typical_page_program_us = 700, \
+    .typical_sector_erase_ms = 45, \
+    .typical_block_erase_ms = 150, \
+    .typical_chip_erase_ms = 10000, \
+    .continuous_read_mode_bits = 0x00, \
+    .quad_io_read_dummy_cycles = 0, \
+    .supports_quad_io_writes = false, \
+    .qpi_read_dummy_cycles = 0, \
+    .typical_block32_erase_ms = 120, \
+    .erase_suspend_us = 20, \
 }
 #endif  // MICROPY_INCLUDED_ATMEL_SAMD_EXTERNAL_FLASH_DEVICES_H
@@ -0,0 +1,1003 @@
+/**
+ * @file Adafruit_QSPI_Host.cpp
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifdef __linux__
+
+#include "Adafruit_QSPI.h"
+#include "Adafruit_QSPI_Trace.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+Adafruit_QSPI_Host QSPI0;
+
+enum
+{
+  HOST_BASE_CLOCK_HZ    = 120000000UL, // same as SAMD51 VARIANT_MCK, used by setClockDivider()
+  HOST_WRITE_STATUS_US  = 10000,       // typical tW of status register write
+
+  HOST_PAGE_SIZE        = 256,
+  HOST_SECTOR_SIZE      = 4*1024,
+  HOST_BLOCK32_SIZE     = 32*1024,
+  HOST_BLOCK_SIZE       = 64*1024,
+
+  HOST_STATUS_WIP       = 0x01,
+  HOST_STATUS_WEL       = 0x02,
+  HOST_STATUS2_SUS      = 0x80,
+
+  HOST_SFDP_BFPT_ADDR   = 0x10,    // after the SFDP header and the single parameter header
+  HOST_SFDP_BFPT_LEN    = 16,      // DWORDs, JESD216B
+  HOST_SFDP_SIZE        = HOST_SFDP_BFPT_ADDR + 4*HOST_SFDP_BFPT_LEN,
+};
+
+// SFDP time field: count-1 in the low count_bits, index of the smallest unit
+// that fits above it
+static uint32_t sfdp_time(uint32_t t, uint8_t count_bits, uint32_t const* units, uint8_t unit_count)
+{
+  uint8_t i = 0;
+  while ( i < unit_count - 1 && (t + units[i] - 1)/units[i] > (1UL << count_bits) ) i++;
+
+  uint32_t count = (t + units[i] - 1)/units[i];
+  if ( count == 0 ) count = 1;
+  if ( count > (1UL << count_bits) ) count = 1UL << count_bits;
+
+  return (i << count_bits) | (count - 1);
+}
+
+static void put32(uint8_t* buf, uint32_t value)
+{
+  buf[0] = (uint8_t) value;
+  buf[1] = (uint8_t) (value >> 8);
+  buf[2] = (uint8_t) (value >> 16);
+  buf[3] = (uint8_t) (value >> 24);
+}
+
+Adafruit_QSPI_Host::Adafruit_QSPI_Host(void)
+{
+  _dev = NULL;
+
+  _mem = NULL;
+  _mem_size = 0;
+  _mem_owned = false;
+  _fd = -1;
+
+  _clock_hz = 4000000UL;
+  _bus_ns_remainder = 0;
+
+  _t_page_program_us = _t_sector_erase_us = _t_block_erase_us = _t_chip_erase_us = 0;
+  _t_block32_erase_us = 0;
+
+  _power_up_flash();
+
+  _enabled = false;
+  _qpi = false;
+  _read_mode = _write_mode = QSPI_XFER_1_1_4;
+  _read_dummy = 8;
+  _crm_bits = 0;
+  _crm_active = false;
+  _addr32 = false;
+
+  _violations = 0;
+  resetCounters();
+}
+
+// Flash state after power up, the status register keeps its non-volatile bits
+void Adafruit_QSPI_Host::_power_up_flash(void)
+{
+  _status[0] = _status[1] = 0;
+  _busy_until_us = 0;
+  _last_command = 0;
+  _erasing = false;
+  _suspended = false;
+  _suspend_remaining_us = 0;
+
+  _flash_qpi = false;
+  _flash_qpi_dummy = 2;
+  _flash_addr32 = false;
+  _flash_crm = false;
+}
+
+void Adafruit_QSPI_Host::resetCounters(void)
+{
+  _transactions = 0;
+  _erases = 0;
+  _erased_bytes = 0;
+  _programmed_bytes = 0;
+}
+
+Adafruit_QSPI_Host::~Adafruit_QSPI_Host()
+{
+  _release_backing();
+}
+
+void Adafruit_QSPI_Host::setFlashDevice(external_flash_device const* dev)
+{
+  // Another chip: blank and freshly powered
+  if ( _mem_owned ) _release_backing();
+  _power_up_flash();
+
+  _dev = dev;
+
+  setTiming(dev->typical_page_program_us, 1000UL*dev->typical_sector_erase_ms,
+            1000UL*dev->typical_block_erase_ms, 1000UL*dev->typical_chip_erase_ms);
+
+  _t_block32_erase_us = 1000UL*dev->typical_block32_erase_ms;
+}
+
+void Adafruit_QSPI_Host::setTiming(uint32_t page_program_us, uint32_t sector_erase_us, uint32_t block_erase_us, uint32_t chip_erase_us)
+{
+  _t_page_program_us = page_program_us;
+  _t_sector_erase_us = sector_erase_us;
+  _t_block_erase_us  = block_erase_us;
+  _t_chip_erase_us   = chip_erase_us;
+}
+
+void Adafruit_QSPI_Host::_release_backing(void)
+{
+  if ( _fd >= 0 )
+  {
+    munmap(_mem, _mem_size);
+    close(_fd);
+    _fd = -1;
+  }
+  else if ( _mem_owned )
+  {
+    free(_mem);
+  }
+
+  _mem = NULL;
+  _mem_size = 0;
+  _mem_owned = false;
+}
+
+bool Adafruit_QSPI_Host::setBackingMemory(uint8_t* mem, uint32_t size)
+{
+  _release_backing();
+
+  _mem = mem;
+  _mem_size = size;
+
+  return mem != NULL;
+}
+
+bool Adafruit_QSPI_Host::setBackingFile(const char* path)
+{
+  if ( !_dev ) return false;
+
+  _release_backing();
+
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if ( fd < 0 ) return false;
+
+  struct stat st;
+  if ( fstat(fd, &st) < 0 )
+  {
+    close(fd);
+    return false;
+  }
+
+  uint32_t const size = _dev->total_size;
+
+  // New file or grown device: the fresh part reads as erased
+  if ( (uint64_t) st.st_size < size )
+  {
+    uint8_t ff[HOST_SECTOR_SIZE];
+    memset(ff, 0xff, sizeof(ff));
+
+    lseek(fd, st.st_size, SEEK_SET);
+    for(uint64_t pos = st.st_size; pos < size; pos += sizeof(ff))
+    {
+      size_t const count = (size_t) min((uint64_t) sizeof(ff), size - pos);
+      if ( write(fd, ff, count) != (ssize_t) count )
+      {
+        close(fd);
+        return false;
+      }
+    }
+  }
+
+  void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if ( mem == MAP_FAILED )
+  {
+    close(fd);
+    return false;
+  }
+
+  _fd = fd;
+  _mem = (uint8_t*) mem;
+  _mem_size = size;
+
+  return true;
+}
+
+void Adafruit_QSPI_Host::begin(int sck, int cs, int io0, int io1, int io2, int io3)
+{
+  (void) sck; (void) cs; (void) io0; (void) io1; (void) io2; (void) io3;
+
+  // Default to a blank chip in RAM
+  if ( !_mem && _dev )
+  {
+    _mem = (uint8_t*) malloc(_dev->total_size);
+    if ( _mem )
+    {
+      memset(_mem, 0xff, _dev->total_size);
+      _mem_size = _dev->total_size;
+      _mem_owned = true;
+    }
+  }
+
+  _clock_hz = 4000000UL; // start with low 4Mhz like the SAMD51 port
+  _bus_ns_remainder = 0;
+
+  _enabled = true;
+  _qpi = false;
+  _read_mode = _write_mode = QSPI_XFER_1_1_4;
+  _read_dummy = 8;
+  _crm_bits = 0;
+  _crm_active = false;
+  _addr32 = false;
+}
+
+// The flash stays powered: contents, status and QPI/4-byte address modes are
+// kept for the next begin()
+void Adafruit_QSPI_Host::end(void)
+{
+  _enabled = false;
+}
+
+// Nothing reaches the flash while the port is disabled
+bool Adafruit_QSPI_Host::_check_enabled(void)
+{
+  if ( !_enabled ) _violations++;
+  return _enabled;
+}
+
+void Adafruit_QSPI_Host::setClockDivider(uint8_t uc_div)
+{
+  _clock_hz = HOST_BASE_CLOCK_HZ / (uc_div ? uc_div : 1);
+
+  qspi_trace_config(QSPI_TRACE_SET_CLOCK, _clock_hz, 0);
+}
+
+void Adafruit_QSPI_Host::setClockSpeed(uint32_t clock_hz)
+{
+  if ( clock_hz ) _clock_hz = clock_hz;
+
+  qspi_trace_config(QSPI_TRACE_SET_CLOCK, _clock_hz, 0);
+}
+
+// Advance simulated time by the duration of SCK cycles on the bus
+void Adafruit_QSPI_Host::_bus_cycles(uint32_t cycles)
+{
+  uint64_t const ns = (1000000000ULL*cycles) / _clock_hz + _bus_ns_remainder;
+
+  host_advance_us(ns / 1000);
+  _bus_ns_remainder = ns % 1000;
+}
+
+// Check WIP and retire the operation in progress once its time has passed
+bool Adafruit_QSPI_Host::_is_busy(void)
+{
+  if ( _busy_until_us && host_time_us() >= _busy_until_us )
+  {
+    _busy_until_us = 0;
+
+    // WEL is reset when the operation completes, not when it is suspended
+    if ( !_suspended )
+    {
+      _status[0] &= ~HOST_STATUS_WEL;
+      _erasing = false;
+    }
+  }
+
+  return _busy_until_us != 0;
+}
+
+// Program, erase and write status all need WEL set and an idle chip, otherwise
+// the real device silently ignores the command.
+bool Adafruit_QSPI_Host::_start_operation(uint32_t duration_us)
+{
+  if ( _is_busy() || _suspended || !(_status[0] & HOST_STATUS_WEL) )
+  {
+    _violations++;
+    return false;
+  }
+
+  _erasing = false;
+  _busy_until_us = host_time_us() + (duration_us ? duration_us : 1);
+  return true;
+}
+
+bool Adafruit_QSPI_Host::setContinuousReadMode(uint8_t mode_bits)
+{
+  _exit_continuous_read();
+  _crm_bits = mode_bits;
+
+  qspi_trace_config(QSPI_TRACE_SET_CONTINUOUS_READ, mode_bits, 0);
+  return true;
+}
+
+bool Adafruit_QSPI_Host::setReadMode(uint8_t xfer_mode, uint8_t dummy_cycles)
+{
+  if ( xfer_mode > QSPI_XFER_4_4_4 ) return false;
+
+  _exit_continuous_read();
+  _read_mode = xfer_mode;
+  _read_dummy = dummy_cycles;
+
+  qspi_trace_config(QSPI_TRACE_SET_READ_MODE, xfer_mode, dummy_cycles);
+  return true;
+}
+
+bool Adafruit_QSPI_Host::setWriteMode(uint8_t xfer_mode)
+{
+  if ( xfer_mode > QSPI_XFER_4_4_4 ) return false;
+
+  _write_mode = xfer_mode;
+  qspi_trace_config(QSPI_TRACE_SET_WRITE_MODE, xfer_mode, 0);
+  return true;
+}
+
+bool Adafruit_QSPI_Host::setAddressLength(uint8_t bits)
+{
+  if ( bits != 24 && bits != 32 ) return false;
+
+  _exit_continuous_read();
+  _addr32 = (bits == 32);
+
+  qspi_trace_config(QSPI_TRACE_SET_ADDRESS_LENGTH, bits, 0);
+  return true;
+}
+
+bool Adafruit_QSPI_Host::setQPI(bool enable)
+{
+  _exit_continuous_read();
+  _qpi = enable;
+
+  if ( !enable )
+  {
+    _read_mode = _write_mode = QSPI_XFER_1_1_4;
+    _read_dummy = 8;
+  }
+
+  qspi_trace_config(QSPI_TRACE_SET_QPI, enable, 0);
+  return true;
+}
+
+// Mode bit reset 0xFF, issued like the SAMD51 port before any command other
+// than the continuous read itself. With 4-byte addresses it must cover the 8
+// address and 2 mode clocks, the SAMD51 port sends 0xFF with a 0xFFFFFF address.
+void Adafruit_QSPI_Host::_exit_continuous_read(void)
+{
+  if ( !_crm_active ) return;
+
+  uint32_t const clocks = _addr32 ? 32 : 8;
+
+  _bus_cycles(clocks);
+  _crm_active = false;
+
+  _leave_continuous_read(QSPI_CMD_CONTINUOUS_READ_RESET, clocks);
+}
+
+// A flash in continuous read mode takes the opcode as the start of the next
+// address. A mode bit reset gets it out if IO0 stays high up to the mode
+// clocks: 8 clocks with 3-byte addresses, 8 address and 2 mode clocks with
+// 4-byte addresses. A shorter one is a violation, the flash stays in
+// continuous read mode.
+// @param reset_clocks  clocks IO0 is high for a mode bit reset
+// @return true if the flash decodes the instruction
+bool Adafruit_QSPI_Host::_leave_continuous_read(uint8_t command, uint32_t reset_clocks)
+{
+  if ( !_flash_crm ) return true;
+
+  // Exit QPI (same opcode) of begin() is sent in QPI mode when the state is
+  // unknown, it ends before the mode clocks
+  if ( command == QSPI_CMD_EXIT_QPI && _qpi ) return false;
+
+  if ( command == QSPI_CMD_CONTINUOUS_READ_RESET )
+  {
+    if ( reset_clocks >= (_flash_addr32 ? 32 : 24)/4 + 2 ) _flash_crm = false;
+    else _violations++;
+
+    return false;
+  }
+
+  _violations++;
+  _flash_crm = false;
+  return false;
+}
+
+// Clocks of the instruction, or of a byte of command data/address
+uint32_t Adafruit_QSPI_Host::_byte_cycles(void)
+{
+  return _qpi ? 2 : 8;
+}
+
+// Clocks of the address, and the address as seen by the flash. Its length
+// must match on both sides: the flash would otherwise take an address byte as
+// data, or the first data byte as address.
+uint32_t Adafruit_QSPI_Host::_address_cycles(uint32_t lines)
+{
+  return (_addr32 ? 32 : 24)/lines;
+}
+
+bool Adafruit_QSPI_Host::_address(uint32_t* addr)
+{
+  if ( _addr32 != _flash_addr32 ) return false;
+
+  if ( !_flash_addr32 ) *addr &= 0xffffff;
+  *addr %= _mem_size;
+
+  return true;
+}
+
+// Flash only decodes instructions sent with its own number of lines
+bool Adafruit_QSPI_Host::_decoded(uint8_t command)
+{
+  if ( _qpi == _flash_qpi ) return true;
+
+  // Exit QPI/mode bit reset is sent in both modes when the state is unknown
+  if ( command != QSPI_CMD_EXIT_QPI ) _violations++;
+
+  return false;
+}
+
+bool Adafruit_QSPI_Host::runCommand(uint8_t command)
+{
+  qspi_trace_scope trace(QSPI_TRACE_RUN_COMMAND, command, 0, 0);
+
+  if ( !_check_enabled() ) return false;
+  _transactions++;
+
+  _exit_continuous_read();
+  _bus_cycles(_byte_cycles());
+
+  uint8_t const last_command = _last_command;
+  _last_command = command;
+
+  if ( !_leave_continuous_read(command, _byte_cycles()) ) return true;
+  if ( !_decoded(command) ) return true;
+
+  // Only reset is accepted while an operation is in progress
+  if ( command == QSPI_CMD_RESET && last_command == QSPI_CMD_ENABLE_RESET )
+  {
+    _busy_until_us = 0;
+    _status[0] &= ~HOST_STATUS_WEL;
+    _status[1] &= ~HOST_STATUS2_SUS;
+    _erasing = _suspended = false;
+    _flash_addr32 = false;
+    return true;
+  }
+
+  // Sector/block erase stops within tSUS, reads are accepted until resumed
+  if ( command == QSPI_CMD_ERASE_SUSPEND )
+  {
+    if ( !_dev || !_dev->erase_suspend_us )
+    {
+      _violations++;
+    }
+    else if ( _is_busy() && _erasing && !_suspended )
+    {
+      uint64_t const now = host_time_us();
+
+      _suspend_remaining_us = _busy_until_us - now;
+      _busy_until_us = now + _dev->erase_suspend_us;
+      _suspended = true;
+      _status[1] |= HOST_STATUS2_SUS;
+    }
+
+    return true;
+  }
+
+  if ( command == QSPI_CMD_ERASE_RESUME )
+  {
+    if ( _suspended && !_is_busy() )
+    {
+      _busy_until_us = host_time_us() + _suspend_remaining_us;
+      _suspended = false;
+      _status[1] &= ~HOST_STATUS2_SUS;
+    }
+
+    return true;
+  }
+
+  if ( command == QSPI_CMD_ENABLE_RESET ) return true;
+
+  if ( command == QSPI_CMD_ERASE_CHIP )
+  {
+    if ( _mem && _start_operation(_t_chip_erase_us) )
+    {
+      memset(_mem, 0xff, _mem_size);
+      _erases++;
+      _erased_bytes += _mem_size;
+    }
+    return true;
+  }
+
+  // Ignored while busy. Not a violation by itself: a lost Write Enable shows up
+  // when the following program/erase is rejected.
+  if ( _is_busy() ) return true;
+
+  switch ( command )
+  {
+    case QSPI_CMD_WRITE_ENABLE:
+      _status[0] |= HOST_STATUS_WEL;
+    break;
+
+    case QSPI_CMD_WRITE_DISABLE:
+      _status[0] &= ~HOST_STATUS_WEL;
+    break;
+
+    case QSPI_CMD_ENABLE_QPI:
+      if ( _dev && _dev->qpi_read_dummy_cycles ) _flash_qpi = true;
+    break;
+
+    case QSPI_CMD_EXIT_QPI:
+      _flash_qpi = false;
+    break;
+
+    // Only devices with more than 16MiB have 4-byte addresses
+    case QSPI_CMD_ENABLE_4B_ADDR:
+      if ( _dev && _dev->total_size > (1UL << 24) ) _flash_addr32 = true;
+    break;
+
+    case QSPI_CMD_EXIT_4B_ADDR:
+      _flash_addr32 = false;
+    break;
+
+    default: break;
+  }
+
+  return true;
+}
+
+bool Adafruit_QSPI_Host::readCommand(uint8_t command, uint8_t* response, uint32_t len)
+{
+  qspi_trace_scope trace(QSPI_TRACE_READ_COMMAND, command, 0, len);
+
+  if ( !_check_enabled() ) return false;
+  _transactions++;
+
+  _exit_continuous_read();
+  _bus_cycles(_byte_cycles()*(1 + len));
+  _last_command = command;
+
+  memset(response, 0xff, len);
+  if ( !_leave_continuous_read(command, 0) ) return true;
+  if ( !_decoded(command) ) return true;
+
+  bool const busy = _is_busy();
+
+  switch ( command )
+  {
+    case QSPI_CMD_READ_STATUS:
+      // Status register is output continuously for as long as it is clocked
+      for(uint32_t i=0; i<len; i++) response[i] = _status[0] | (busy ? HOST_STATUS_WIP : 0);
+    break;
+
+    case QSPI_CMD_READ_STATUS2:
+      for(uint32_t i=0; i<len; i++) response[i] = _status[1];
+    break;
+
+    case QSPI_CMD_READ_JEDEC_ID:
+      if ( busy )
+      {
+        _violations++;
+      }
+      else if ( _dev )
+      {
+        uint8_t const ids[3] = { _dev->manufacturer_id, _dev->memory_type, _dev->capacity };
+        memcpy(response, ids, min(len, 3UL));
+      }
+    break;
+
+    default: break;
+  }
+
+  return true;
+}
+
+bool Adafruit_QSPI_Host::writeCommand(uint8_t command, uint8_t const* data, uint32_t len)
+{
+  qspi_trace_scope trace(QSPI_TRACE_WRITE_COMMAND, command, qspi_trace_command_data(data, len), len);
+
+  if ( !_check_enabled() ) return false;
+  _transactions++;
+
+  _exit_continuous_read();
+  _bus_cycles(_byte_cycles()*(1 + len));
+  _last_command = command;
+
+  // Data bytes of 0xFF extend a mode bit reset
+  uint32_t reset_bytes = 1;
+  while ( reset_bytes <= len && data && data[reset_bytes - 1] == 0xff ) reset_bytes++;
+
+  if ( !_leave_continuous_read(command, _byte_cycles()*reset_bytes) ) return true;
+  if ( !_decoded(command) ) return true;
+
+  // Dummy cycles of QPI reads: 2, 4, 6 or 8 in bits 5-4
+  if ( command == QSPI_CMD_SET_READ_PARAMS && data && len && _flash_qpi )
+  {
+    _flash_qpi_dummy = 2*(((data[0] >> 4) & 0x03) + 1);
+    return true;
+  }
+
+  if ( command != QSPI_CMD_WRITE_STATUS && command != QSPI_CMD_WRITE_STATUS2 ) return true;
+  if ( !data || !len || !_start_operation(HOST_WRITE_STATUS_US) ) return true;
+
+  // WIP and WEL are read-only, they are not affected by the written value
+  if ( command == QSPI_CMD_WRITE_STATUS )
+  {
+    _status[0] = (_status[0] & (HOST_STATUS_WIP | HOST_STATUS_WEL)) | (data[0] & ~(HOST_STATUS_WIP | HOST_STATUS_WEL));
+    if ( len > 1 ) _status[1] = data[1];
+  }
+  else
+  {
+    _status[1] = data[0];
+  }
+
+  return true;
+}
+
+bool Adafruit_QSPI_Host::eraseCommand(uint8_t command, uint32_t address)
+{
+  qspi_trace_scope trace(QSPI_TRACE_ERASE_COMMAND, command, address, 0);
+
+  if ( !_check_enabled() ) return false;
+  _transactions++;
+
+  _exit_continuous_read();
+  _bus_cycles(_byte_cycles() + _address_cycles(_qpi ? 4 : 1));
+  _last_command = command;
+
+  if ( !_leave_continuous_read(command, 0) ) return true;
+  if ( !_decoded(command) ) return true;
+
+  uint32_t size;
+  uint32_t duration_us;
+
+  if ( command == QSPI_CMD_ERASE_SECTOR )
+  {
+    size = HOST_SECTOR_SIZE;
+    duration_us = _t_sector_erase_us;
+  }
+  else if ( command == QSPI_CMD_ERASE_BLOCK )
+  {
+    size = HOST_BLOCK_SIZE;
+    duration_us = _t_block_erase_us;
+  }
+  else if ( command == QSPI_CMD_ERASE_BLOCK32 )
+  {
+    // Ignored by devices without 32KiB block erase
+    if ( !_dev || !_dev->typical_block32_erase_ms )
+    {
+      _violations++;
+      return true;
+    }
+
+    size = HOST_BLOCK32_SIZE;
+    duration_us = _t_block32_erase_us;
+  }
+  else
+  {
+    return false;
+  }
+
+  if ( !_mem ) return true;
+
+  if ( !_address(&address) )
+  {
+    _violations++;
+    return true;
+  }
+
+  if ( !_start_operation(duration_us) ) return true;
+  _erasing = true;
+  _erases++;
+  _erased_bytes += size;
+
+  // Address is truncated to the start of the sector/block
+  address &= ~(size - 1);
+  memset(_mem + address, 0xff, min(size, _mem_size - address));
+
+  return true;
+}
+
+// JESD216B SFDP of the emulated device: SFDP header, one parameter header
+// and a Basic Flash Parameter Table with what the device table knows
+void Adafruit_QSPI_Host::_sfdp_table(uint8_t* sfdp)
+{
+  static uint32_t const erase_units[]   = { 1, 16, 128, 1000 };       // ms
+  static uint32_t const program_units[] = { 8, 64 };                  // us
+  static uint32_t const chip_units[]    = { 16, 256, 4000, 64000 };   // ms
+  static uint32_t const suspend_units[] = { 128, 1000, 8000, 64000 }; // ns
+
+  external_flash_device const* dev = _dev;
+  uint32_t dw[HOST_SFDP_BFPT_LEN+1];
+  memset(dw, 0, sizeof(dw));
+
+  // 4KiB erase, quad reads, 3 or 4-byte addresses
+  dw[1] = 0xff8000e1UL | (QSPI_CMD_ERASE_SECTOR << 8);
+  if ( dev->supports_qspi ) dw[1] |= 1UL << 22;
+  if ( dev->quad_io_read_dummy_cycles ) dw[1] |= 1UL << 21;
+  if ( dev->total_size > (1UL << 24) ) dw[1] |= 1UL << 17;
+
+  dw[2] = 8*dev->total_size - 1;
+
+  // 1-1-4 0x6B and 1-4-4 0xEB with 2 mode clocks
+  if ( dev->supports_qspi ) dw[3] |= ((uint32_t) QSPI_CMD_QUAD_READ << 24) | (8UL << 16);
+  if ( dev->quad_io_read_dummy_cycles )
+  {
+    dw[3] |= (QSPI_CMD_QUAD_IO_READ << 8) | (2UL << 5) | dev->quad_io_read_dummy_cycles;
+  }
+
+  // No 2-2-2, 4-4-4 with 0xEB
+  dw[5] = 0xffffffeeUL;
+  dw[6] = 0x0000ffffUL;
+  dw[7] = 0x0000ffffUL;
+  if ( dev->qpi_read_dummy_cycles )
+  {
+    dw[5] |= 1UL << 4;
+    dw[7] |= ((uint32_t) QSPI_CMD_QUAD_IO_READ << 24) | (2UL << 21) | ((dev->qpi_read_dummy_cycles - 2UL) << 16);
+  }
+
+  // Erase types 4KiB, 32KiB if supported, 64KiB and their typical times
+  uint32_t types[4] = { 0 };
+  uint32_t times = 0x01; // maximum = 4 x typical
+  uint8_t n = 0;
+
+  types[n] = (QSPI_CMD_ERASE_SECTOR << 8) | 12;
+  times |= sfdp_time(dev->typical_sector_erase_ms, 5, erase_units, 4) << (4 + 7*n++);
+
+  if ( dev->typical_block32_erase_ms )
+  {
+    types[n] = (QSPI_CMD_ERASE_BLOCK32 << 8) | 15;
+    times |= sfdp_time(dev->typical_block32_erase_ms, 5, erase_units, 4) << (4 + 7*n++);
+  }
+
+  types[n] = (QSPI_CMD_ERASE_BLOCK << 8) | 16;
+  times |= sfdp_time(dev->typical_block_erase_ms, 5, erase_units, 4) << (4 + 7*n++);
+
+  dw[8]  = types[0] | (types[1] << 16);
+  dw[9]  = types[2] | (types[3] << 16);
+  dw[10] = times;
+
+  // 256-byte pages, page program and chip erase
+  dw[11] = 0x01 | (8UL << 4) |
+           (sfdp_time(dev->typical_page_program_us, 5, program_units, 2) << 8) |
+           (sfdp_time(dev->typical_chip_erase_ms, 5, chip_units, 4) << 24);
+
+  // Erase suspend/resume 0x75/0x7A
+  if ( dev->erase_suspend_us )
+  {
+    dw[12] = sfdp_time(1000UL*dev->erase_suspend_us, 5, suspend_units, 4) << 24;
+    dw[13] = ((uint32_t) QSPI_CMD_ERASE_SUSPEND << 24) | ((uint32_t) QSPI_CMD_ERASE_RESUME << 16) |
+             (QSPI_CMD_ERASE_SUSPEND << 8) | QSPI_CMD_ERASE_RESUME;
+  }else
+  {
+    dw[12] = 0x80000000UL;
+  }
+
+  dw[14] = 0xffffffffUL;
+
+  // Quad enable requirements, QPI entry with 0x38, 0-4-4 mode entry/exit
+  uint32_t qer = 0;
+  if ( dev->quad_enable_bit_mask == 0x40 && dev->single_status_byte ) qer = 2;
+  else if ( dev->quad_enable_bit_mask == 0x02 ) qer = dev->write_status_register_split ? 6 : 4;
+
+  dw[15] = qer << 20;
+  if ( dev->qpi_read_dummy_cycles ) dw[15] |= (0x02 << 4) | 0x01;
+  if ( dev->continuous_read_mode_bits )
+  {
+    dw[15] |= (1UL << 9) | (0x02 << 10) | ((dev->continuous_read_mode_bits == 0xa5 ? 0x01UL : 0x04UL) << 16);
+  }
+
+  // 4-byte addresses: enter with 0xB7, exit with 0xE9, reset with 0x66/0x99
+  dw[16] = (0x10UL << 8) | 0x7f;
+  if ( dev->total_size > (1UL << 24) ) dw[16] |= (0x01UL << 24) | (0x01UL << 14);
+
+  memset(sfdp, 0xff, HOST_SFDP_SIZE);
+
+  put32(sfdp + 0, 0x50444653UL);            // "SFDP"
+  put32(sfdp + 4, 0xff000106UL);            // rev 1.6, 1 parameter header
+  put32(sfdp + 8, 0x00000600UL | ((uint32_t) HOST_SFDP_BFPT_LEN << 24)); // BFPT rev 1.6
+  put32(sfdp + 12, 0xff000000UL | HOST_SFDP_BFPT_ADDR);
+
+  for(uint8_t i=1; i<=HOST_SFDP_BFPT_LEN; i++) put32(sfdp + HOST_SFDP_BFPT_ADDR + 4*(i-1), dw[i]);
+}
+
+bool Adafruit_QSPI_Host::readSFDP(uint32_t addr, uint8_t* data, uint32_t len)
+{
+  if ( _qpi || !_check_enabled() ) return false;
+
+  // 1 line instruction and 3-byte address whatever the address mode, 8 dummy cycles
+  _exit_continuous_read();
+  _bus_cycles(8 + 24 + 8 + 8*len);
+  _transactions++;
+  _last_command = QSPI_CMD_READ_SFDP;
+
+  memset(data, 0xff, len);
+  if ( !_leave_continuous_read(QSPI_CMD_READ_SFDP, 0) ) return true;
+  if ( !_decoded(QSPI_CMD_READ_SFDP) || !_dev ) return true;
+
+  if ( _is_busy() )
+  {
+    _violations++;
+    return true;
+  }
+
+  uint8_t sfdp[HOST_SFDP_SIZE];
+  _sfdp_table(sfdp);
+
+  for(uint32_t i=0; i<len && addr + i < HOST_SFDP_SIZE; i++) data[i] = sfdp[addr + i];
+
+  return true;
+}
+
+bool Adafruit_QSPI_Host::readMemory(uint32_t addr, uint8_t *data, uint32_t len)
+{
+  qspi_trace_scope trace(QSPI_TRACE_READ_MEMORY, 0, addr, len);
+
+  if ( !_check_enabled() ) return false;
+  _transactions++;
+
+  bool valid;
+
+  if ( _read_mode == QSPI_XFER_1_4_4 )
+  {
+    // 0xEB: instruction only until the flash is in continuous read mode,
+    // 4 line address, 2 mode cycles, dummy cycles, 4 line data
+    _bus_cycles((_crm_active ? 0 : 8) + _address_cycles(4) + 2 + _read_dummy + 2*len);
+    _last_command = QSPI_CMD_QUAD_IO_READ;
+
+    valid = _dev && _dev->quad_io_read_dummy_cycles && _read_dummy == _dev->quad_io_read_dummy_cycles;
+
+    // Opcode skipped: the flash must be in continuous read mode, else it
+    // takes the address as an opcode
+    if ( _crm_active ? !_flash_crm : !_leave_continuous_read(QSPI_CMD_QUAD_IO_READ, 0) ) valid = false;
+    if ( _crm_bits ) _crm_active = true;
+  }
+  else if ( _read_mode == QSPI_XFER_4_4_4 )
+  {
+    // 0x0B in QPI mode: 4 line instruction, address and data
+    _bus_cycles(2 + _address_cycles(4) + _read_dummy + 2*len);
+    _last_command = QSPI_CMD_FAST_READ;
+
+    valid = (_read_dummy == _flash_qpi_dummy) && _leave_continuous_read(QSPI_CMD_FAST_READ, 0);
+  }
+  else
+  {
+    // 0x6B: 1 line instruction and address, dummy cycles, 4 line data
+    _bus_cycles(8 + _address_cycles(1) + _read_dummy + 2*len);
+    _last_command = QSPI_CMD_QUAD_READ;
+
+    valid = (_read_dummy == 8) && _leave_continuous_read(QSPI_CMD_QUAD_READ, 0);
+  }
+
+  valid = valid && (_qpi == _flash_qpi) && _mem && _address(&addr);
+
+  // Flash only stays in continuous read mode with its own mode bits
+  _flash_crm = valid && _read_mode == QSPI_XFER_1_4_4 && _crm_bits && _crm_bits == _dev->continuous_read_mode_bits;
+
+  if ( !_mem || _is_busy() || !valid )
+  {
+    // Flash does not answer read while busy or missed the instruction, data is undefined
+    _violations++;
+    memset(data, 0xff, len);
+    return true;
+  }
+
+  // Read wraps around at the end of the address space
+  for(uint32_t i=0; i<len; i++) data[i] = _mem[(addr + i) % _mem_size];
+
+  return true;
+}
+
+bool Adafruit_QSPI_Host::writeMemory(uint32_t addr, uint8_t *data, uint32_t len)
+{
+  qspi_trace_scope trace(QSPI_TRACE_WRITE_MEMORY, 0, addr, len);
+
+  if ( !_check_enabled() ) return false;
+  _transactions++;
+
+  _exit_continuous_read();
+
+  bool valid;
+
+  if ( _write_mode == QSPI_XFER_1_4_4 )
+  {
+    // 0x38: 1 line instruction, 4 line address and data. Enable QPI on parts without it.
+    _bus_cycles(8 + _address_cycles(4) + 2*len);
+    _last_command = QSPI_CMD_QUAD_IO_PAGE_PROGRAM;
+
+    valid = _dev && _dev->supports_quad_io_writes;
+  }
+  else if ( _write_mode == QSPI_XFER_4_4_4 )
+  {
+    // 0x02 in QPI mode: 4 line instruction, address and data
+    _bus_cycles(2 + _address_cycles(4) + 2*len);
+    _last_command = QSPI_CMD_PAGE_PROGRAM;
+
+    valid = true;
+  }
+  else
+  {
+    // 0x32: 1 line instruction and address, 4 line data
+    _bus_cycles(8 + _address_cycles(1) + 2*len);
+    _last_command = QSPI_CMD_QUAD_PAGE_PROGRAM;
+
+    valid = true;
+  }
+
+  if ( !_leave_continuous_read(_last_command, 0) || !_mem ) return true;
+
+  if ( !valid || _qpi != _flash_qpi || !_address(&addr) )
+  {
+    _violations++;
+    return true;
+  }
+
+  if ( !_start_operation(_t_page_program_us) ) return true;
+
+  // The page is the one of the start address, data wraps around inside it
+  uint32_t const page_addr = addr & ~(HOST_PAGE_SIZE - 1UL);
+
+  // More than a page of data: only the last 256 bytes are programmed,
+  // starting at offset (addr + len - 256) within the page
+  if ( len > HOST_PAGE_SIZE )
+  {
+    addr += len - HOST_PAGE_SIZE;
+    data += len - HOST_PAGE_SIZE;
+    len = HOST_PAGE_SIZE;
+  }
+
+  _programmed_bytes += len;
+
+  // Program only clears bits, and wraps around within the page
+  for(uint32_t i=0; i<len; i++)
+  {
+    _mem[page_addr + ((addr + i) % HOST_PAGE_SIZE)] &= data[i];
+  }
+
+  return true;
+}
+
+// The backing memory is the mapped window
+uint8_t const* Adafruit_QSPI_Host::mapMemory(uint32_t addr, uint32_t len)
+{
+  if ( !_enabled || !_mem || (uint64_t) addr + len > _mem_size ) return NULL;
+
+  return _mem + addr;
+}
+
+void Adafruit_QSPI_Host::unmapMemory(void)
+{
+  // nothing to do
+}
+
+#endif
@@ -0,0 +1,190 @@
+/**
+ * @file Adafruit_QSPI_Host.h
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach for Adafruit Industries LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ADAFRUIT_QSPI_HOST_H_
+#define ADAFRUIT_QSPI_HOST_H_
+
+#include "../external_flash_device.h"
+
+/**************************************************************************/
+/*!
+    @brief  Simulated QSPI port for Linux hosts. The external flash is modeled
+    on top of a RAM buffer or a memory-mapped file with NOR semantics: page
+    program can only clear bits and wraps inside the 256-byte page, erase sets
+    bytes to 0xFF, and the WIP/WEL status bits follow the device's typical
+    program/erase times on the simulated clock (see extras/host).
+*/
+/**************************************************************************/
+class Adafruit_QSPI_Host : Adafruit_QSPI
+{
+  public:
+    Adafruit_QSPI_Host(void);
+    ~Adafruit_QSPI_Host();
+
+    virtual void begin(int sck, int cs, int io0, int io1, int io2, int io3);
+    using Adafruit_QSPI::begin;
+
+    /// Disable the port. The emulated flash stays powered and keeps its
+    /// contents and state, any transfer before the next begin() is a violation.
+    void end(void);
+
+    virtual void setClockDivider(uint8_t uc_div);
+    virtual void setClockSpeed(uint32_t clock_hz);
+
+    virtual bool runCommand(uint8_t command);
+    virtual bool readCommand(uint8_t command, uint8_t* response, uint32_t len);
+    virtual bool writeCommand(uint8_t command, uint8_t const* data, uint32_t len);
+
+    virtual bool eraseCommand(uint8_t command, uint32_t address);
+    virtual bool readMemory(uint32_t addr, uint8_t *data, uint32_t len);
+    virtual bool writeMemory(uint32_t addr, uint8_t *data, uint32_t len);
+    virtual bool readSFDP(uint32_t addr, uint8_t* data, uint32_t len);
+
+    virtual uint8_t const* mapMemory(uint32_t addr, uint32_t len);
+    virtual void unmapMemory(void);
+
+    virtual bool setContinuousReadMode(uint8_t mode_bits);
+    virtual bool setReadMode(uint8_t xfer_mode, uint8_t dummy_cycles);
+    virtual bool setWriteMode(uint8_t xfer_mode);
+    virtual bool setQPI(bool enable);
+    virtual bool setAddressLength(uint8_t bits);
+
+    using Adafruit_QSPI::readMemoryAsync;
+    using Adafruit_QSPI::writeMemoryAsync;
+    using Adafruit_QSPI::eraseCommandAsync;
+    using Adafruit_QSPI::busy;
+    using Adafruit_QSPI::task;
+    using Adafruit_QSPI::hasReadyWait;
+    using Adafruit_QSPI::waitReady;
+
+    //------------- Simulation setup -------------//
+
+    /// Select the emulated flash device, must be called before begin().
+    /// Its typical program/erase times are used as latencies. The device
+    /// starts powered up, and blank unless backing memory or file is set.
+    /// @param dev  device description, must stay valid while in use
+    void setFlashDevice(external_flash_device const* dev);
+
+    /// Use caller's RAM as flash contents instead of an internal allocation
+    /// @param mem   backing memory, at least device total_size bytes
+    /// @param size  size of mem in bytes
+    /// @return true if success
+    bool setBackingMemory(uint8_t* mem, uint32_t size);
+
+    /// Use a memory-mapped file as flash contents, so that data persists
+    /// across runs. The file is created and filled with 0xFF if needed.
+    /// @param path  file path
+    /// @return true if success
+    bool setBackingFile(const char* path);
+
+    /// Override the latencies taken from the device table, the 32KiB block
+    /// erase time always comes from the table
+    /// @param page_program_us  page program time in microseconds
+    /// @param sector_erase_us  4KiB sector erase time in microseconds
+    /// @param block_erase_us   64KiB block erase time in microseconds
+    /// @param chip_erase_us    chip erase time in microseconds
+    void setTiming(uint32_t page_program_us, uint32_t sector_erase_us, uint32_t block_erase_us, uint32_t chip_erase_us);
+
+    /// Number of commands the flash ignored or that returned undefined data,
+    /// e.g program without Write Enable or read while busy. A correct driver
+    /// keeps this at zero.
+    uint32_t violations(void) { return _violations; }
+
+    /// Activity since construction or resetCounters(), e.g to compare the
+    /// bus traffic and flash wear of two driver versions
+    uint32_t transactions(void) { return _transactions; }        ///< commands and memory transfers
+    uint32_t erases(void) { return _erases; }                    ///< sector, block and chip erases started
+    uint64_t erasedBytes(void) { return _erased_bytes; }         ///< bytes set to 0xFF by erases
+    uint64_t programmedBytes(void) { return _programmed_bytes; } ///< bytes sent by accepted page programs
+
+    /// Clear transactions(), erases(), erasedBytes() and programmedBytes()
+    void resetCounters(void);
+
+  private:
+    external_flash_device const* _dev;
+
+    uint8_t* _mem;
+    uint32_t _mem_size;
+    bool     _mem_owned;
+    int      _fd;
+
+    uint32_t _clock_hz;
+    uint32_t _bus_ns_remainder;
+
+    uint32_t _t_page_program_us;
+    uint32_t _t_sector_erase_us;
+    uint32_t _t_block_erase_us;
+    uint32_t _t_block32_erase_us;
+    uint32_t _t_chip_erase_us;
+
+    uint8_t  _status[2];
+    uint64_t _busy_until_us;
+    uint8_t  _last_command;
+    bool     _erasing;   // sector/block erase, can be suspended
+    bool     _suspended;
+    uint64_t _suspend_remaining_us;
+
+    // port side transfer modes
+    bool     _qpi;
+    uint8_t  _read_mode;
+    uint8_t  _read_dummy;
+    uint8_t  _write_mode;
+    uint8_t  _crm_bits;
+    bool     _crm_active;
+    bool     _addr32;
+    bool     _enabled;
+
+    // flash side QPI, address length and continuous read state
+    bool     _flash_qpi;
+    uint8_t  _flash_qpi_dummy;
+    bool     _flash_addr32;
+    bool     _flash_crm;
+
+    uint32_t _violations;
+    uint32_t _transactions;
+    uint32_t _erases;
+    uint64_t _erased_bytes;
+    uint64_t _programmed_bytes;
+
+    void _release_backing(void);
+    void _power_up_flash(void);
+    bool _check_enabled(void);
+    void _bus_cycles(uint32_t cycles);
+    bool _is_busy(void);
+    bool _start_operation(uint32_t duration_us);
+    void _exit_continuous_read(void);
+    bool _leave_continuous_read(uint8_t command, uint32_t reset_clocks);
+    uint32_t _byte_cycles(void);
+    bool _decoded(uint8_t command);
+    uint32_t _address_cycles(uint32_t lines);
+    bool _address(uint32_t* addr);
+    void _sfdp_table(uint8_t* sfdp);
+};
+
+extern Adafruit_QSPI_Host QSPI0; ///< default QSPI instance
+typedef Adafruit_QSPI_Host Adafruit_QSPI_Port; ///< port class of QSPI0
+
+#endif /* ADAFRUIT_QSPI_HOST_H_ */
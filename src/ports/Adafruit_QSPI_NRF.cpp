@@ -27,13 +27,93 @@
 #ifdef NRF52840_XXAA
 
 #include "Adafruit_QSPI.h"
+#include "Adafruit_QSPI_Trace.h"
 #include "nrfx_qspi.h"
 
 Adafruit_QSPI_NRF QSPI0;
 
-Adafruit_QSPI_NRF::Adafruit_QSPI_NRF(void)
+// True while a read/write/erase transfer started with nrfx is in progress,
+// cleared by the QSPI event handler
+static volatile bool _xfer_busy = false;
+
+static void _qspi_event_handler(nrfx_qspi_evt_t event, void* p_context)
 {
+  (void) p_context;
 
+  if ( event == NRFX_QSPI_EVENT_DONE ) _xfer_busy = false;
+}
+
+// Must be called right after a transfer is started with _xfer_busy set
+static bool _xfer_started(nrfx_err_t err)
+{
+  if ( err != NRFX_SUCCESS ) _xfer_busy = false;
+  return err == NRFX_SUCCESS;
+}
+
+static void _wait_xfer(void)
+{
+  while ( _xfer_busy ) {}
+}
+
+//--------------------------------------------------------------------+
+// Alignment
+// EasyDMA of read/write tasks needs a word aligned buffer in RAM, a word
+// aligned address and a length multiple of 4. Other transfers go through a
+// bounce buffer as large as a page, so that a page program still takes a
+// single write task.
+//--------------------------------------------------------------------+
+enum
+{
+  QSPI_BOUNCE_SIZE = 256,
+};
+
+static uint32_t _bounce[QSPI_BOUNCE_SIZE/4];
+
+static bool _dma_capable(uint32_t addr, void const* buf, uint32_t len)
+{
+  return !((addr | (uint32_t) buf | len) & 3) && nrfx_is_in_ram(buf);
+}
+
+static bool _xfer_read(uint32_t addr, uint8_t* data, uint32_t len)
+{
+  _xfer_busy = true;
+  if ( !_xfer_started(nrfx_qspi_read(data, len, addr)) ) return false;
+
+  _wait_xfer();
+  return true;
+}
+
+static bool _xfer_write(uint32_t addr, uint8_t const* data, uint32_t len)
+{
+  _xfer_busy = true;
+  if ( !_xfer_started(nrfx_qspi_write(data, len, addr)) ) return false;
+
+  _wait_xfer();
+  return true;
+}
+
+// Read the enclosing aligned words into the bounce buffer, chunk by chunk
+static bool _bounce_read(uint32_t addr, uint8_t* data, uint32_t len)
+{
+  while ( len )
+  {
+    uint32_t const offset = addr & 3;
+    uint32_t const count  = min(len, QSPI_BOUNCE_SIZE - offset);
+
+    if ( !_xfer_read(addr - offset, (uint8_t*) _bounce, (offset + count + 3) & ~3UL) ) return false;
+    memcpy(data, ((uint8_t*) _bounce) + offset, count);
+
+    addr += count;
+    data += count;
+    len  -= count;
+  }
+
+  return true;
+}
+
+Adafruit_QSPI_NRF::Adafruit_QSPI_NRF(void)
+{
+  _pin_cs = -1;
 }
 
 void Adafruit_QSPI_NRF::begin(int sck, int cs, int io0, int io1, int io2, int io3)
@@ -64,8 +144,28 @@ void Adafruit_QSPI_NRF::begin(int sck, int cs, int io0, int io1, int io2, int io
     .irq_priority = 7
   };
 
-  // No callback for blocking API
-  nrfx_qspi_init(&qspi_cfg, NULL, NULL);
+  // Event handler makes read/write/erase non-blocking, blocking API waits on _xfer_busy
+  nrfx_qspi_init(&qspi_cfg, _qspi_event_handler, NULL);
+  _pin_cs = cs;
+}
+
+/**
+ * Complete a transfer in progress, then disable the QSPI. nrfx returns the
+ * pins to their default disconnected state, chip select is then pulled up so
+ * that the flash stays deselected. The flash itself is left as is, see
+ * Adafruit_QSPI_Flash::end().
+ */
+void Adafruit_QSPI_NRF::end(void)
+{
+  if ( _pin_cs < 0 ) return;
+
+  while ( busy() ) task();
+  _wait_xfer();
+
+  nrfx_qspi_uninit();
+
+  pinMode(_pin_cs, INPUT_PULLUP);
+  _pin_cs = -1;
 }
 
 void Adafruit_QSPI_NRF::setClockDivider (uint8_t uc_div)
@@ -77,6 +177,8 @@ void Adafruit_QSPI_NRF::setClockDivider (uint8_t uc_div)
 
   NRF_QSPI->IFCONFIG1 &= ~(QSPI_IFCONFIG1_SCKFREQ_Msk | QSPI_IFCONFIG1_SCKDELAY_Msk);
   NRF_QSPI->IFCONFIG1 |= (uc_div << QSPI_IFCONFIG1_SCKFREQ_Pos) | (delay << QSPI_IFCONFIG1_SCKDELAY_Pos);
+
+  qspi_trace_config(QSPI_TRACE_SET_CLOCK, 32000000UL/(uc_div + 1), 0);
 }
 
 void Adafruit_QSPI_NRF::setClockSpeed(uint32_t clock_hz)
@@ -93,8 +195,88 @@ void Adafruit_QSPI_NRF::setClockSpeed(uint32_t clock_hz)
   setClockDivider(clkdiv);
 }
 
+// Read/write opcodes are taken from IFCONFIG0 by every transfer, including
+// XIP. QPI (4-4-4) is not supported by the peripheral.
+bool Adafruit_QSPI_NRF::setReadMode(uint8_t xfer_mode, uint8_t dummy_cycles)
+{
+  uint32_t readoc;
+
+  if ( xfer_mode == QSPI_XFER_1_1_4 )
+  {
+    readoc = NRF_QSPI_READOC_READ4O;  // 0x6B, 8 dummy cycles
+  }
+  else if ( xfer_mode == QSPI_XFER_1_4_4 && dummy_cycles == 4 )
+  {
+    readoc = NRF_QSPI_READOC_READ4IO; // 0xEB, mode bits then 4 dummy cycles
+  }
+  else
+  {
+    return false;
+  }
+
+  _wait_xfer();
+
+  NRF_QSPI->IFCONFIG0 = (NRF_QSPI->IFCONFIG0 & ~QSPI_IFCONFIG0_READOC_Msk) | (readoc << QSPI_IFCONFIG0_READOC_Pos);
+  qspi_trace_config(QSPI_TRACE_SET_READ_MODE, xfer_mode, dummy_cycles);
+  return true;
+}
+
+// Address length of read/write/erase tasks and XIP. Custom instructions are
+// not affected, their address bytes are sent as data.
+bool Adafruit_QSPI_NRF::setAddressLength(uint8_t bits)
+{
+  uint32_t addrmode;
+
+  if ( bits == 24 )
+  {
+    addrmode = NRF_QSPI_ADDRMODE_24BIT;
+  }
+  else if ( bits == 32 )
+  {
+    addrmode = NRF_QSPI_ADDRMODE_32BIT;
+  }
+  else
+  {
+    return false;
+  }
+
+  _wait_xfer();
+
+  NRF_QSPI->IFCONFIG0 = (NRF_QSPI->IFCONFIG0 & ~QSPI_IFCONFIG0_ADDRMODE_Msk) | (addrmode << QSPI_IFCONFIG0_ADDRMODE_Pos);
+  qspi_trace_config(QSPI_TRACE_SET_ADDRESS_LENGTH, bits, 0);
+  return true;
+}
+
+bool Adafruit_QSPI_NRF::setWriteMode(uint8_t xfer_mode)
+{
+  uint32_t writeoc;
+
+  if ( xfer_mode == QSPI_XFER_1_1_4 )
+  {
+    writeoc = NRF_QSPI_WRITEOC_PP4O;  // 0x32
+  }
+  else if ( xfer_mode == QSPI_XFER_1_4_4 )
+  {
+    writeoc = NRF_QSPI_WRITEOC_PP4IO; // 0x38
+  }
+  else
+  {
+    return false;
+  }
+
+  _wait_xfer();
+
+  NRF_QSPI->IFCONFIG0 = (NRF_QSPI->IFCONFIG0 & ~QSPI_IFCONFIG0_WRITEOC_Msk) | (writeoc << QSPI_IFCONFIG0_WRITEOC_Pos);
+  qspi_trace_config(QSPI_TRACE_SET_WRITE_MODE, xfer_mode, 0);
+  return true;
+}
+
 bool Adafruit_QSPI_NRF::runCommand(uint8_t command)
 {
+  qspi_trace_scope trace(QSPI_TRACE_RUN_COMMAND, command, 0, 0);
+
+  _wait_xfer();
+
   nrf_qspi_cinstr_conf_t cinstr_cfg =
   {
     .opcode    = command,
@@ -110,6 +292,10 @@ bool Adafruit_QSPI_NRF::runCommand(uint8_t command)
 
 bool Adafruit_QSPI_NRF::readCommand(uint8_t command, uint8_t* response, uint32_t len)
 {
+  qspi_trace_scope trace(QSPI_TRACE_READ_COMMAND, command, 0, len);
+
+  _wait_xfer();
+
   nrf_qspi_cinstr_conf_t cinstr_cfg =
   {
     .opcode    = command,
@@ -124,6 +310,10 @@ bool Adafruit_QSPI_NRF::readCommand(uint8_t command, uint8_t* response, uint32_t
 
 bool Adafruit_QSPI_NRF::writeCommand(uint8_t command, uint8_t const* data, uint32_t len)
 {
+  qspi_trace_scope trace(QSPI_TRACE_WRITE_COMMAND, command, qspi_trace_command_data(data, len), len);
+
+  _wait_xfer();
+
   nrf_qspi_cinstr_conf_t cinstr_cfg =
   {
       .opcode    = command,
@@ -136,34 +326,263 @@ bool Adafruit_QSPI_NRF::writeCommand(uint8_t command, uint8_t const* data, uint3
   return nrfx_qspi_cinstr_xfer(&cinstr_cfg, data, NULL) == NRFX_SUCCESS;
 }
 
-bool Adafruit_QSPI_NRF::eraseCommand(uint8_t command, uint32_t address)
+/**
+ * Wait for the flash to be ready with the WIPWAIT feature of custom
+ * instructions: the peripheral polls the status register on its own before
+ * sending Read Status, then its READY event ends the wait.
+ * @param timeout_us give up after this many microseconds
+ * @return true if ready, false on timeout
+ */
+bool Adafruit_QSPI_NRF::waitReady(uint32_t timeout_us)
 {
-  nrf_qspi_erase_len_t erase_len;
+  _wait_xfer();
 
+  nrf_qspi_cinstr_conf_t cinstr_cfg =
+  {
+    .opcode    = QSPI_CMD_READ_STATUS,
+    .length    = NRF_QSPI_CINSTR_LEN_2B,
+    .io2_level = true,
+    .io3_level = true,
+    .wipwait   = true,
+    .wren      = false
+  };
+
+  // Started with the HAL so that READY is reported by the event handler
+  // instead of nrfx busy waiting on it
+  _xfer_busy = true;
+  nrf_qspi_event_clear(NRF_QSPI, NRF_QSPI_EVENT_READY);
+  nrf_qspi_int_enable(NRF_QSPI, NRF_QSPI_INT_READY_MASK);
+  nrf_qspi_cinstr_transfer_start(NRF_QSPI, &cinstr_cfg);
+
+  uint32_t const start_us = micros();
+  while ( _xfer_busy )
+  {
+    if ( (uint32_t) (micros() - start_us) >= timeout_us )
+    {
+      // Abandon the instruction, re-activation signals READY once done
+      NRF_QSPI->TASKS_DEACTIVATE = 1;
+      NRF_QSPI->TASKS_ACTIVATE = 1;
+      _wait_xfer();
+
+      return false;
+    }
+
+    yield();
+  }
+
+  return true;
+}
+
+static bool _erase_len(uint8_t command, nrf_qspi_erase_len_t* erase_len)
+{
   if ( command == QSPI_CMD_ERASE_SECTOR )
   {
-    erase_len = NRF_QSPI_ERASE_LEN_4KB;
+    *erase_len = NRF_QSPI_ERASE_LEN_4KB;
   }
   else if ( command == QSPI_CMD_ERASE_BLOCK )
   {
-    erase_len = NRF_QSPI_ERASE_LEN_64KB;
+    *erase_len = NRF_QSPI_ERASE_LEN_64KB;
   }
   else
   {
     return false;
   }
 
-  return NRFX_SUCCESS == nrfx_qspi_erase(erase_len, address);
+  return true;
 }
 
+bool Adafruit_QSPI_NRF::eraseCommand(uint8_t command, uint32_t address)
+{
+  qspi_trace_scope trace(QSPI_TRACE_ERASE_COMMAND, command, address, 0);
+
+  // No erase task for 32KB blocks, address is sent as custom instruction data
+  if ( command == QSPI_CMD_ERASE_BLOCK32 )
+  {
+    uint8_t const addr[4] = { (uint8_t) (address >> 24), (uint8_t) (address >> 16), (uint8_t) (address >> 8), (uint8_t) address };
+    bool const addr32 = (NRF_QSPI->IFCONFIG0 & QSPI_IFCONFIG0_ADDRMODE_Msk) != 0;
+
+    return addr32 ? writeCommand(command, addr, 4) : writeCommand(command, addr + 1, 3);
+  }
+
+  nrf_qspi_erase_len_t erase_len;
+  if ( !_erase_len(command, &erase_len) ) return false;
+
+  _wait_xfer();
+
+  _xfer_busy = true;
+  if ( !_xfer_started(nrfx_qspi_erase(erase_len, address)) ) return false;
+
+  _wait_xfer();
+  return true;
+}
+
+/**
+ * Read SFDP with custom instructions: the 3 address bytes and 8 dummy clocks
+ * take 4 of the 8 data bytes, each instruction returns the 4 others.
+ */
+bool Adafruit_QSPI_NRF::readSFDP(uint32_t addr, uint8_t* data, uint32_t len)
+{
+  _wait_xfer();
+
+  nrf_qspi_cinstr_conf_t cinstr_cfg =
+  {
+    .opcode    = QSPI_CMD_READ_SFDP,
+    .length    = NRF_QSPI_CINSTR_LEN_9B,
+    .io2_level = true,
+    .io3_level = true,
+    .wipwait   = false,
+    .wren      = false
+  };
+
+  while ( len )
+  {
+    uint8_t const tx[8] = { (uint8_t) (addr >> 16), (uint8_t) (addr >> 8), (uint8_t) addr, 0xff, 0xff, 0xff, 0xff, 0xff };
+    uint8_t rx[8];
+
+    if ( nrfx_qspi_cinstr_xfer(&cinstr_cfg, tx, rx) != NRFX_SUCCESS ) return false;
+
+    uint32_t const count = min(len, (uint32_t) 4);
+    memcpy(data, rx + 4, count);
+
+    addr += count;
+    data += count;
+    len  -= count;
+  }
+
+  return true;
+}
+
+/**
+ * Read with DMA straight into data whenever possible: only the unaligned
+ * head and tail words of a buffer that shares the alignment of the address
+ * are bounced, otherwise the whole range is.
+ */
 bool Adafruit_QSPI_NRF::readMemory (uint32_t addr, uint8_t *data, uint32_t len)
 {
-  return NRFX_SUCCESS == nrfx_qspi_read(data, len, addr);
+  qspi_trace_scope trace(QSPI_TRACE_READ_MEMORY, 0, addr, len);
+
+  _wait_xfer();
+
+  if ( _dma_capable(addr, data, len) ) return _xfer_read(addr, data, len);
+
+  uint32_t const head = (4 - (addr & 3)) & 3;
+
+  if ( !((addr ^ (uint32_t) data) & 3) && nrfx_is_in_ram(data) && len >= head + 4 )
+  {
+    uint32_t const middle = (len - head) & ~3UL;
+
+    if ( head && !_bounce_read(addr, data, head) ) return false;
+    if ( !_xfer_read(addr + head, data + head, middle) ) return false;
+
+    return _bounce_read(addr + head + middle, data + head + middle, len - head - middle);
+  }
+
+  return _bounce_read(addr, data, len);
 }
 
+/**
+ * Program with DMA straight from data if aligned. Otherwise the enclosing
+ * words are programmed from the bounce buffer, padded with 0xFF which leaves
+ * the neighbor bytes unchanged. As with any page program, data must not cross
+ * a page boundary.
+ */
 bool Adafruit_QSPI_NRF::writeMemory (uint32_t addr, uint8_t *data, uint32_t len)
 {
-  return NRFX_SUCCESS == nrfx_qspi_write(data, len, addr);
+  qspi_trace_scope trace(QSPI_TRACE_WRITE_MEMORY, 0, addr, len);
+
+  _wait_xfer();
+
+  if ( _dma_capable(addr, data, len) ) return _xfer_write(addr, data, len);
+
+  uint32_t const offset = addr & 3;
+  uint32_t const span   = (offset + len + 3) & ~3UL;
+  if ( span > QSPI_BOUNCE_SIZE ) return false;
+
+  memset(_bounce, 0xff, span);
+  memcpy(((uint8_t*) _bounce) + offset, data, len);
+
+  return _xfer_write(addr - offset, (uint8_t const*) _bounce, span);
+}
+
+//--------------------------------------------------------------------+
+// Memory mapped (XIP)
+// XIP reads are served by the peripheral whenever it is enabled and idle,
+// using the configured read opcode.
+//--------------------------------------------------------------------+
+enum
+{
+  QSPI_XIP_START_ADDR  = 0x12000000UL,
+  QSPI_XIP_WINDOW_SIZE = 0x08000000UL,
+};
+
+uint8_t const* Adafruit_QSPI_NRF::mapMemory(uint32_t addr, uint32_t len)
+{
+  if ( (uint64_t) addr + len > QSPI_XIP_WINDOW_SIZE ) return NULL;
+
+  // XIP access must not overlap with a running task
+  _wait_xfer();
+
+  return ((uint8_t const*) QSPI_XIP_START_ADDR) + addr;
+}
+
+void Adafruit_QSPI_NRF::unmapMemory(void)
+{
+  // nothing to do
+}
+
+//--------------------------------------------------------------------+
+// Asynchronous API
+// EasyDMA moves the data in background, completion is signaled by the
+// QSPI READY event. Program/erase then continue with status polling in task().
+//--------------------------------------------------------------------+
+
+bool Adafruit_QSPI_NRF::readMemoryAsync(uint32_t addr, uint8_t *data, uint32_t len, qspi_callback_t cb, void* arg)
+{
+  // Bounced transfers complete right away, callback is deferred to task()
+  if ( !_dma_capable(addr, data, len) ) return Adafruit_QSPI::readMemoryAsync(addr, data, len, cb, arg);
+
+  if ( busy() ) return false;
+
+  _xfer_busy = true;
+  if ( !_xfer_started(nrfx_qspi_read(data, len, addr)) ) return false;
+
+  _async_begin(false, cb, arg);
+  return true;
+}
+
+bool Adafruit_QSPI_NRF::writeMemoryAsync(uint32_t addr, uint8_t *data, uint32_t len, qspi_callback_t cb, void* arg)
+{
+  if ( !_dma_capable(addr, data, len) ) return Adafruit_QSPI::writeMemoryAsync(addr, data, len, cb, arg);
+
+  if ( busy() ) return false;
+
+  _xfer_busy = true;
+  if ( !_xfer_started(nrfx_qspi_write(data, len, addr)) ) return false;
+
+  _async_begin(true, cb, arg);
+  return true;
+}
+
+bool Adafruit_QSPI_NRF::eraseCommandAsync(uint8_t command, uint32_t address, qspi_callback_t cb, void* arg)
+{
+  // 32KB block erase is a custom instruction, short enough to send right
+  // away, task() then polls the status register like for the other erases
+  if ( command == QSPI_CMD_ERASE_BLOCK32 ) return Adafruit_QSPI::eraseCommandAsync(command, address, cb, arg);
+
+  nrf_qspi_erase_len_t erase_len;
+  if ( busy() || !_erase_len(command, &erase_len) ) return false;
+
+  _xfer_busy = true;
+  if ( !_xfer_started(nrfx_qspi_erase(erase_len, address)) ) return false;
+
+  _async_begin(true, cb, arg);
+  return true;
+}
+
+bool Adafruit_QSPI_NRF::_async_xfer_complete(bool* result)
+{
+  *result = true;
+  return !_xfer_busy;
 }
 
 #endif
@@ -35,6 +35,7 @@ class Adafruit_QSPI_NRF : Adafruit_QSPI
     virtual void begin(int sck, int cs, int io0, int io1, int io2, int io3);
     using Adafruit_QSPI::begin;
 
+    /// Disable the QSPI and release the pins
     void end(void);
 
     virtual void setClockDivider(uint8_t uc_div);
@@ -46,9 +47,36 @@ class Adafruit_QSPI_NRF : Adafruit_QSPI
 
     virtual bool eraseCommand(uint8_t command, uint32_t address);
     virtual bool readMemory(uint32_t addr, uint8_t *data, uint32_t len);
+    virtual bool readSFDP(uint32_t addr, uint8_t* data, uint32_t len);
     virtual bool writeMemory(uint32_t addr, uint8_t *data, uint32_t len);
+
+    virtual bool readMemoryAsync(uint32_t addr, uint8_t *data, uint32_t len, qspi_callback_t cb, void* arg);
+    virtual bool writeMemoryAsync(uint32_t addr, uint8_t *data, uint32_t len, qspi_callback_t cb, void* arg);
+    virtual bool eraseCommandAsync(uint8_t command, uint32_t address, qspi_callback_t cb, void* arg);
+
+    virtual uint8_t const* mapMemory(uint32_t addr, uint32_t len);
+    virtual void unmapMemory(void);
+
+    using Adafruit_QSPI::busy;
+    using Adafruit_QSPI::task;
+    using Adafruit_QSPI::setContinuousReadMode;
+    using Adafruit_QSPI::setQPI;
+
+    virtual bool setReadMode(uint8_t xfer_mode, uint8_t dummy_cycles);
+    virtual bool setWriteMode(uint8_t xfer_mode);
+    virtual bool setAddressLength(uint8_t bits);
+
+    virtual bool hasReadyWait(void) { return true; }
+    virtual bool waitReady(uint32_t timeout_us);
+
+  protected:
+    virtual bool _async_xfer_complete(bool* result);
+
+  private:
+    int _pin_cs; // -1 if not started
 };
 
 extern Adafruit_QSPI_NRF QSPI0;
+typedef Adafruit_QSPI_NRF Adafruit_QSPI_Port; ///< port class of QSPI0
 
 #endif /* ADAFRUIT_QSPI_NRF_H_ */
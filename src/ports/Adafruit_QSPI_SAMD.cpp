@@ -26,6 +26,8 @@
 #ifdef __SAMD51__
 
 #include "Adafruit_QSPI.h"
+#include "Adafruit_QSPI_Stats.h"
+#include "Adafruit_QSPI_Trace.h"
 #include "wiring_private.h"
 
 Adafruit_QSPI_SAMD QSPI0;
@@ -36,6 +38,8 @@ static void samd_peripherals_disable_and_clear_cache(void)
   CMCC->CTRL.bit.CEN = 0;
   while ( CMCC->SR.bit.CSTS ) { }
   CMCC->MAINT0.bit.INVALL = 1;
+
+  qspi_stats_event(QSPI_STATS_CACHE_FLUSH);
 }
 
 // Enable cache
@@ -44,9 +48,121 @@ static void samd_peripherals_enable_cache (void)
   CMCC->CTRL.bit.CEN = 1;
 }
 
+// Address and data phases of memory read/write, lines are set by the transfer mode
+static uint32_t const _memory_iframe = QSPI_INSTRFRAME_INSTREN | QSPI_INSTRFRAME_ADDREN | QSPI_INSTRFRAME_DATAEN;
+
+// Whether the instruction changes flash contents visible through the AHB window
+static bool _modifies_contents(uint8_t command, uint32_t iframe)
+{
+  if ( (iframe & QSPI_INSTRFRAME_TFRTYPE_Msk) == QSPI_INSTRFRAME_TFRTYPE_WRITEMEMORY ) return true;
+
+  switch ( command )
+  {
+    case QSPI_CMD_ERASE_SECTOR:
+    case QSPI_CMD_ERASE_BLOCK:
+    case QSPI_CMD_ERASE_BLOCK32:
+    case QSPI_CMD_ERASE_CHIP:
+      return true;
+
+    default: return false;
+  }
+}
+
+//--------------------------------------------------------------------+
+// DMA
+// The data phase of memory read/write is moved by the DMAC between SRAM and
+// the QSPI_AHB window. Bursts of 16 bytes (4 words, or 16 bytes when buffers
+// are unaligned) keep the AHB busy without starving other bus masters.
+//--------------------------------------------------------------------+
+
+// Channel is taken from the top so that it doesn't collide with Adafruit_ZeroDMA
+// which allocates from channel 0.
+#ifndef ADAFRUIT_QSPI_DMA_CHANNEL
+#define ADAFRUIT_QSPI_DMA_CHANNEL   (DMAC_CH_NUM-1)
+#endif
+
+enum
+{
+  QSPI_DMA_MIN_LEN   = 64,        ///< shorter transfers are copied by CPU, DMA setup costs more
+  QSPI_DMA_CHUNK_LEN = 32*1024,   ///< max bytes per instruction, within the 65535 beats of a DMA block
+  QSPI_AHB_WINDOW_SIZE = 16*1024*1024, ///< QSPI_AHB memory space
+};
+
+// Descriptor tables are only used when no one else (e.g Adafruit_ZeroDMA) has
+// set up the DMAC yet, otherwise the channel's entry of the existing table is used.
+static DmacDescriptor _dma_desc[DMAC_CH_NUM] __attribute__ ((aligned (16)));
+static DmacDescriptor _dma_wb[DMAC_CH_NUM] __attribute__ ((aligned (16)));
+
+static void _dma_init(void)
+{
+  if ( DMAC->CTRL.bit.DMAENABLE ) return;
+
+  MCLK->AHBMASK.bit.DMAC_ = 1;
+
+  DMAC->CTRL.bit.SWRST = 1;
+  while ( DMAC->CTRL.bit.SWRST ) {}
+
+  DMAC->BASEADDR.reg = (uint32_t) _dma_desc;
+  DMAC->WRBADDR.reg  = (uint32_t) _dma_wb;
+  DMAC->CTRL.reg     = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xF);
+}
+
+// Start a memory to memory transfer of at most QSPI_DMA_CHUNK_LEN bytes
+static void _dma_start(void* dst, void const* src, uint32_t len)
+{
+  DmacChannel* ch = &DMAC->Channel[ADAFRUIT_QSPI_DMA_CHANNEL];
+  DmacDescriptor* desc = ((DmacDescriptor*) DMAC->BASEADDR.reg) + ADAFRUIT_QSPI_DMA_CHANNEL;
+
+  bool const word = !(((uint32_t) dst | (uint32_t) src | len) & 3UL);
+
+  // With address increment, SRCADDR/DSTADDR point to the end of the transfer
+  desc->BTCTRL.reg   = DMAC_BTCTRL_VALID | DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_DSTINC | DMAC_BTCTRL_BLOCKACT_NOACT |
+                       (word ? DMAC_BTCTRL_BEATSIZE_WORD : DMAC_BTCTRL_BEATSIZE_BYTE);
+  desc->BTCNT.reg    = word ? len/4 : len;
+  desc->SRCADDR.reg  = ((uint32_t) src) + len;
+  desc->DSTADDR.reg  = ((uint32_t) dst) + len;
+  desc->DESCADDR.reg = 0;
+
+  ch->CHCTRLA.bit.ENABLE = 0;
+  while ( ch->CHCTRLA.bit.ENABLE ) {}
+
+  // Software trigger, the whole transaction runs on one trigger
+  ch->CHCTRLA.reg   = DMAC_CHCTRLA_TRIGSRC(0) | DMAC_CHCTRLA_TRIGACT_TRANSACTION |
+                      (word ? DMAC_CHCTRLA_BURSTLEN_4BEAT : DMAC_CHCTRLA_BURSTLEN_16BEAT);
+  ch->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+  ch->CHCTRLA.bit.ENABLE = 1;
+
+  DMAC->SWTRIGCTRL.reg = (1UL << ADAFRUIT_QSPI_DMA_CHANNEL);
+}
+
+static bool _dma_complete(void)
+{
+  return DMAC->Channel[ADAFRUIT_QSPI_DMA_CHANNEL].CHINTFLAG.bit.TCMPL;
+}
+
 Adafruit_QSPI_SAMD::Adafruit_QSPI_SAMD(void)
 {
+  for(uint8_t i=0; i<6; i++) _pins[i] = -1;
+
+  _async_addr = 0;
+  _async_buf = NULL;
+  _async_remain = 0;
+  _async_dma = false;
+
+  _cache_policy = QSPI_CACHE_FLUSH_ALWAYS;
+  _flush_on_end = false;
+
+  _mapped = false;
 
+  _qpi = false;
+  _read_mode = QSPI_XFER_1_1_4;
+  _read_dummy = 8;
+  _write_mode = QSPI_XFER_1_1_4;
+  _crm_bits = 0;
+  _crm_active = false;
+  _addr32 = false;
+
+  _update_memory_frames();
 }
 
 void Adafruit_QSPI_SAMD::begin(int sck, int cs, int io0, int io1, int io2, int io3)
@@ -63,6 +179,9 @@ void Adafruit_QSPI_SAMD::begin(int sck, int cs, int io0, int io1, int io2, int i
 	pinPeripheral(io2, PIO_COM);
 	pinPeripheral(io3, PIO_COM);
 
+	_pins[0] = sck; _pins[1] = cs;
+	_pins[2] = io0; _pins[3] = io1; _pins[4] = io2; _pins[5] = io3;
+
 	QSPI->CTRLA.bit.SWRST = 1;
 
 	delay(1); //no syncbusy reg.. do we need this? Probably not
@@ -72,6 +191,354 @@ void Adafruit_QSPI_SAMD::begin(int sck, int cs, int io0, int io1, int io2, int i
 	QSPI->BAUD.reg = QSPI_BAUD_BAUD(VARIANT_MCK/4000000UL); // start with low 4Mhz, Mode 0
 
 	QSPI->CTRLA.bit.ENABLE = 1;
+
+	_dma_init();
+
+	// Back to 1-1-4 without continuous read, the flash itself is switched back
+	// by Adafruit_QSPI_Flash::begin()
+	_crm_active = false;
+	_addr32 = false;
+	setContinuousReadMode(0);
+	setQPI(false);
+}
+
+/**
+ * Complete a transfer in progress, then disable the QSPI and gate its clocks.
+ * Pins go back to GPIO inputs, chip select with a pull-up so that the flash
+ * stays deselected. The flash itself is left as is, see Adafruit_QSPI_Flash::end().
+ */
+void Adafruit_QSPI_SAMD::end(void)
+{
+  if ( _pins[0] < 0 ) return;
+
+  while ( busy() ) task();
+  unmapMemory();
+
+  QSPI->CTRLA.bit.ENABLE = 0;
+
+  MCLK->APBCMASK.reg &= ~MCLK_APBCMASK_QSPI;
+  MCLK->AHBMASK.reg &= ~(MCLK_AHBMASK_QSPI | MCLK_AHBMASK_QSPI_2X);
+
+  for(uint8_t i=0; i<6; i++) pinMode(_pins[i], i == 1 ? INPUT_PULLUP : INPUT);
+  _pins[0] = -1;
+
+  _crm_active = false;
+}
+
+//--------------------------------------------------------------------+
+// Instruction
+//--------------------------------------------------------------------+
+
+void Adafruit_QSPI_SAMD::_start_instruction(uint8_t command, uint32_t iframe, uint32_t addr)
+{
+  if ( _cache_policy == QSPI_CACHE_FLUSH_ALWAYS )
+  {
+    samd_peripherals_disable_and_clear_cache();
+  }
+
+  _flush_on_end = (_cache_policy == QSPI_CACHE_FLUSH_ON_WRITE) && _modifies_contents(command, iframe);
+
+	// Release chip select held by accesses to the mapped window
+	if ( _mapped ) QSPI->CTRLA.reg = QSPI_CTRLA_ENABLE | QSPI_CTRLA_LASTXFER;
+
+	// In continuous read mode the flash would take the opcode as address bits
+	if ( _crm_active && !(iframe & QSPI_INSTRFRAME_CRMODE) ) _exit_continuous_read();
+	if ( iframe & QSPI_INSTRFRAME_CRMODE ) _crm_active = true;
+
+	QSPI->INSTRCTRL.reg = QSPI_INSTRCTRL_INSTR(command) | QSPI_INSTRCTRL_OPTCODE(_crm_bits);
+	QSPI->INSTRADDR.reg = addr;
+
+	QSPI->INSTRFRAME.reg = iframe;
+
+	// Dummy read of INSTRFRAME needed to synchronize.
+	// See Instruction Transmission Flow Diagram, figure 37.9, page 995
+	// and Example 4, page 998, section 37.6.8.5.
+	(volatile uint32_t) QSPI->INSTRFRAME.reg;
+}
+
+void Adafruit_QSPI_SAMD::_end_instruction(void)
+{
+	__asm__ volatile ("dsb");
+	__asm__ volatile ("isb");
+
+	QSPI->CTRLA.reg = QSPI_CTRLA_ENABLE | QSPI_CTRLA_LASTXFER;
+
+	while( !QSPI->INTFLAG.bit.INSTREND ) {}
+	QSPI->INTFLAG.bit.INSTREND = 1;
+
+	// Drop lines cached from the window (e.g code executed in place) that the
+	// program/erase just made stale.
+	if ( _cache_policy == QSPI_CACHE_FLUSH_ALWAYS || _flush_on_end )
+	{
+	  if ( _flush_on_end ) samd_peripherals_disable_and_clear_cache();
+	  samd_peripherals_enable_cache();
+	}
+
+	if ( _mapped ) _enter_memory_mode();
+}
+
+// Leave a read memory frame configured without LASTXFER: system bus accesses to
+// the QSPI_AHB window then issue the read instruction on their own.
+void Adafruit_QSPI_SAMD::_enter_memory_mode(void)
+{
+	if ( _crm_bits ) _crm_active = true;
+
+	QSPI->INSTRCTRL.reg = QSPI_INSTRCTRL_INSTR(_read_command) | QSPI_INSTRCTRL_OPTCODE(_crm_bits);
+	QSPI->INSTRFRAME.reg = _read_frame;
+	(volatile uint32_t) QSPI->INSTRFRAME.reg;
+}
+
+// Mode bit reset: 0xFF clocked on IO0 is read back as mode bits that do not
+// match the continuous read pattern of any supported flash, which then
+// expects an opcode again. With 4-byte addresses the mode bits come after 8
+// quad address clocks, out of reach of 8 clocks: the 0xFFFFFF address phase
+// keeps IO0 high for 32 clocks in total.
+void Adafruit_QSPI_SAMD::_exit_continuous_read(void)
+{
+	QSPI->INSTRCTRL.reg = QSPI_INSTRCTRL_INSTR(QSPI_CMD_CONTINUOUS_READ_RESET);
+	QSPI->INSTRADDR.reg = 0xFFFFFFFFUL;
+	QSPI->INSTRFRAME.reg = QSPI_INSTRFRAME_WIDTH_SINGLE_BIT_SPI | QSPI_INSTRFRAME_ADDRLEN_24BITS |
+	                       QSPI_INSTRFRAME_TFRTYPE_READ | QSPI_INSTRFRAME_INSTREN |
+	                       (_addr32 ? QSPI_INSTRFRAME_ADDREN : 0);
+	(volatile uint32_t) QSPI->INSTRFRAME.reg;
+
+	QSPI->CTRLA.reg = QSPI_CTRLA_ENABLE | QSPI_CTRLA_LASTXFER;
+
+	while( !QSPI->INTFLAG.bit.INSTREND ) {}
+	QSPI->INTFLAG.bit.INSTREND = 1;
+
+	_crm_active = false;
+}
+
+//--------------------------------------------------------------------+
+// Transfer modes
+//--------------------------------------------------------------------+
+
+// Compute instructions and frames of memory read/write for the selected modes
+void Adafruit_QSPI_SAMD::_update_memory_frames(void)
+{
+  // Only one instruction at a time: finish the asynchronous read if any
+  while ( _async_dma && !_async_read_poll() ) {}
+
+  if ( _mapped ) QSPI->CTRLA.reg = QSPI_CTRLA_ENABLE | QSPI_CTRLA_LASTXFER;
+  if ( _crm_active ) _exit_continuous_read();
+
+  uint32_t const memory_iframe = _memory_iframe | _address_length();
+
+  switch ( _read_mode )
+  {
+    case QSPI_XFER_1_4_4:
+      // Mode bits are sent as option code. With Continuous Read Mode the
+      // instruction is only sent again after the mode has been reset.
+      _read_command = QSPI_CMD_QUAD_IO_READ;
+      _read_frame   = QSPI_INSTRFRAME_WIDTH_QUAD_IO | QSPI_INSTRFRAME_TFRTYPE_READMEMORY | memory_iframe |
+                      QSPI_INSTRFRAME_OPTCODEEN | QSPI_INSTRFRAME_OPTCODELEN_8BITS | QSPI_INSTRFRAME_DUMMYLEN(_read_dummy) |
+                      (_crm_bits ? QSPI_INSTRFRAME_CRMODE : 0);
+    break;
+
+    case QSPI_XFER_4_4_4:
+      _read_command = QSPI_CMD_FAST_READ;
+      _read_frame   = QSPI_INSTRFRAME_WIDTH_QUAD_CMD | QSPI_INSTRFRAME_TFRTYPE_READMEMORY | memory_iframe |
+                      QSPI_INSTRFRAME_DUMMYLEN(_read_dummy);
+    break;
+
+    default:
+      _read_command = QSPI_CMD_QUAD_READ;
+      _read_frame   = QSPI_INSTRFRAME_WIDTH_QUAD_OUTPUT | QSPI_INSTRFRAME_TFRTYPE_READMEMORY | memory_iframe |
+                      QSPI_INSTRFRAME_DUMMYLEN(_read_dummy);
+    break;
+  }
+
+  switch ( _write_mode )
+  {
+    case QSPI_XFER_1_4_4:
+      _write_command = QSPI_CMD_QUAD_IO_PAGE_PROGRAM;
+      _write_frame   = QSPI_INSTRFRAME_WIDTH_QUAD_IO | QSPI_INSTRFRAME_TFRTYPE_WRITEMEMORY | memory_iframe;
+    break;
+
+    case QSPI_XFER_4_4_4:
+      _write_command = QSPI_CMD_PAGE_PROGRAM;
+      _write_frame   = QSPI_INSTRFRAME_WIDTH_QUAD_CMD | QSPI_INSTRFRAME_TFRTYPE_WRITEMEMORY | memory_iframe;
+    break;
+
+    default:
+      _write_command = QSPI_CMD_QUAD_PAGE_PROGRAM;
+      _write_frame   = QSPI_INSTRFRAME_WIDTH_QUAD_OUTPUT | QSPI_INSTRFRAME_TFRTYPE_WRITEMEMORY | memory_iframe;
+    break;
+  }
+
+  // Register transfer for addresses beyond the QSPI_AHB window, which has no
+  // continuous read mode: 0xEB then falls back to 0x6B
+  if ( _read_frame & QSPI_INSTRFRAME_CRMODE )
+  {
+    _far_read_command = QSPI_CMD_QUAD_READ;
+    _far_read_frame   = QSPI_INSTRFRAME_WIDTH_QUAD_OUTPUT | memory_iframe | QSPI_INSTRFRAME_DUMMYLEN(8);
+  }
+  else
+  {
+    _far_read_command = _read_command;
+    _far_read_frame   = _read_frame & ~QSPI_INSTRFRAME_TFRTYPE_Msk;
+  }
+
+  _far_read_frame  |= QSPI_INSTRFRAME_TFRTYPE_READ;
+  _far_write_frame  = (_write_frame & ~QSPI_INSTRFRAME_TFRTYPE_Msk) | QSPI_INSTRFRAME_TFRTYPE_WRITE;
+
+  if ( _mapped ) _enter_memory_mode();
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Select the memory read instruction. With Fast Read Quad I/O 0xEB
+    (1-4-4) the address takes 6 clocks instead of 24, with QPI 0x0B (4-4-4)
+    the instruction also takes 2 clocks instead of 8.
+
+    @param xfer_mode QSPI_XFER_1_1_4, QSPI_XFER_1_4_4 or QSPI_XFER_4_4_4
+    @param dummy_cycles dummy clocks, after the mode bits for QSPI_XFER_1_4_4
+    @returns true
+*/
+/**************************************************************************/
+bool Adafruit_QSPI_SAMD::setReadMode(uint8_t xfer_mode, uint8_t dummy_cycles)
+{
+  if ( xfer_mode > QSPI_XFER_4_4_4 ) return false;
+
+  _read_mode = xfer_mode;
+  _read_dummy = dummy_cycles;
+  _update_memory_frames();
+
+  qspi_trace_config(QSPI_TRACE_SET_READ_MODE, xfer_mode, dummy_cycles);
+  return true;
+}
+
+bool Adafruit_QSPI_SAMD::setWriteMode(uint8_t xfer_mode)
+{
+  if ( xfer_mode > QSPI_XFER_4_4_4 ) return false;
+
+  _write_mode = xfer_mode;
+  _update_memory_frames();
+
+  qspi_trace_config(QSPI_TRACE_SET_WRITE_MODE, xfer_mode, 0);
+  return true;
+}
+
+bool Adafruit_QSPI_SAMD::setQPI(bool enable)
+{
+  _qpi = enable;
+
+  if ( !enable )
+  {
+    _read_mode = QSPI_XFER_1_1_4;
+    _read_dummy = 8;
+    _write_mode = QSPI_XFER_1_1_4;
+  }
+
+  _update_memory_frames();
+
+  qspi_trace_config(QSPI_TRACE_SET_QPI, enable, 0);
+  return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Set the address length of memory read/write and erase frames,
+    including the mapped window. The flash must be switched by the caller.
+
+    @param bits 24 or 32
+    @returns true if bits is supported
+*/
+/**************************************************************************/
+bool Adafruit_QSPI_SAMD::setAddressLength(uint8_t bits)
+{
+  if ( bits != 24 && bits != 32 ) return false;
+
+  _addr32 = (bits == 32);
+  _update_memory_frames();
+
+  qspi_trace_config(QSPI_TRACE_SET_ADDRESS_LENGTH, bits, 0);
+  return true;
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Keep the flash in continuous read mode between QSPI_XFER_1_4_4
+    reads, including the mapped window. Instructions of the following reads
+    are skipped by the QSPI (CRMODE). Any other instruction is preceded by a
+    mode bit reset.
+
+    @param mode_bits option code that keeps the flash in continuous read mode
+    e.g 0xA0 for Winbond, 0 to disable
+    @returns true
+*/
+/**************************************************************************/
+bool Adafruit_QSPI_SAMD::setContinuousReadMode(uint8_t mode_bits)
+{
+  _crm_bits = mode_bits;
+  _update_memory_frames();
+
+  qspi_trace_config(QSPI_TRACE_SET_CONTINUOUS_READ, mode_bits, 0);
+  return true;
+}
+
+uint8_t const* Adafruit_QSPI_SAMD::mapMemory(uint32_t addr, uint32_t len)
+{
+  if ( (uint64_t) addr + len > QSPI_AHB_WINDOW_SIZE ) return NULL;
+
+  // Only one instruction at a time: finish the asynchronous read if any
+  while ( _async_dma && !_async_read_poll() ) {}
+
+  _mapped = true;
+  _enter_memory_mode();
+
+  return ((uint8_t const*) QSPI_AHB) + addr;
+}
+
+void Adafruit_QSPI_SAMD::unmapMemory(void)
+{
+  if ( !_mapped ) return;
+
+  _mapped = false;
+
+  // Close the pending memory read frame
+  QSPI->CTRLA.reg = QSPI_CTRLA_ENABLE | QSPI_CTRLA_LASTXFER;
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Select when the Cortex-M cache controller (CMCC) is flushed.
+
+    QSPI_CACHE_FLUSH_ALWAYS (default) disables and invalidates the whole cache
+    around every instruction, including each status register poll. That
+    evicts the application's hot code and data over and over, for thousands
+    of times while waiting on a single erase.
+
+    QSPI_CACHE_FLUSH_ON_WRITE keeps the CMCC enabled. Its data cache is turned
+    off instead, so that command responses and data read through the QSPI_AHB
+    window are never served from stale lines, while the instruction cache
+    keeps running. The cache is invalidated only after instructions that
+    change flash contents (page program and erase), which is what code or
+    data executed/read in place from the window needs.
+
+    The data cache is turned off for the whole system, not only for the
+    QSPI_AHB window: data reads from internal flash (e.g const tables) are no
+    longer cached either, until QSPI_CACHE_FLUSH_ALWAYS is selected again.
+    The CMCC can only invalidate lines by index and way, not by address, so
+    dropping just the window lines is not cheaper than invalidating all.
+
+    The gain depends on how much of the application runs out of cache:
+    compare status poll and small read timings on the target with both policies.
+
+    @param policy QSPI_CACHE_FLUSH_ALWAYS or QSPI_CACHE_FLUSH_ON_WRITE
+*/
+/**************************************************************************/
+void Adafruit_QSPI_SAMD::setCachePolicy(uint8_t policy)
+{
+  if ( policy == _cache_policy ) return;
+
+  // CFG can only be written while the cache is disabled
+  samd_peripherals_disable_and_clear_cache();
+  CMCC->CFG.bit.DCDIS = (policy == QSPI_CACHE_FLUSH_ON_WRITE) ? 1 : 0;
+  samd_peripherals_enable_cache();
+
+  _cache_policy = policy;
 }
 
 /**************************************************************************/
@@ -86,27 +553,31 @@ void Adafruit_QSPI_SAMD::begin(int sck, int cs, int io0, int io1, int io2, int i
 /**************************************************************************/
 bool Adafruit_QSPI_SAMD::_run_instruction(uint8_t command, uint32_t iframe, uint32_t addr, uint8_t *buffer, uint32_t size)
 {
-  samd_peripherals_disable_and_clear_cache();
-
-	uint8_t *qspi_mem = (uint8_t *)QSPI_AHB;
-	if(addr)
-		qspi_mem += addr;
+  // Only one instruction at a time: finish the asynchronous read if any
+  while ( _async_dma && !_async_read_poll() ) {}
 
-	QSPI->INSTRCTRL.bit.INSTR = command;
-	QSPI->INSTRADDR.reg = addr;
-
-	QSPI->INSTRFRAME.reg = iframe;
-
-	// Dummy read of INSTRFRAME needed to synchronize.
-	// See Instruction Transmission Flow Diagram, figure 37.9, page 995
-	// and Example 4, page 998, section 37.6.8.5.
-	(volatile uint32_t) QSPI->INSTRFRAME.reg;
+  _start_instruction(command, iframe, addr);
 
 	if ( buffer && size )
 	{
+	  // Register transfers beyond the window take their address from INSTRADDR
+	  uint8_t *qspi_mem = ((uint8_t *)QSPI_AHB) + (addr < QSPI_AHB_WINDOW_SIZE ? addr : 0);
 	  uint32_t const tfr_type = iframe & QSPI_INSTRFRAME_TFRTYPE_Msk;
+	  bool const is_read = (tfr_type == QSPI_INSTRFRAME_TFRTYPE_READ) || (tfr_type == QSPI_INSTRFRAME_TFRTYPE_READMEMORY);
 
-	  if ( (tfr_type == QSPI_INSTRFRAME_TFRTYPE_READ) || (tfr_type == QSPI_INSTRFRAME_TFRTYPE_READMEMORY) )
+	  if ( size >= QSPI_DMA_MIN_LEN )
+	  {
+	    if ( is_read )
+	    {
+	      _dma_start(buffer, qspi_mem, size);
+	    }else
+	    {
+	      _dma_start(qspi_mem, buffer, size);
+	    }
+
+	    while ( !_dma_complete() ) {}
+	  }
+	  else if ( is_read )
 	  {
 	    memcpy(buffer, qspi_mem, size);
 	  }else
@@ -115,22 +586,16 @@ bool Adafruit_QSPI_SAMD::_run_instruction(uint8_t command, uint32_t iframe, uint
 	  }
 	}
 
-	__asm__ volatile ("dsb");
-	__asm__ volatile ("isb");
-
-	QSPI->CTRLA.reg = QSPI_CTRLA_ENABLE | QSPI_CTRLA_LASTXFER;
-
-	while( !QSPI->INTFLAG.bit.INSTREND ) {}
-	QSPI->INTFLAG.bit.INSTREND = 1;
-
-	samd_peripherals_enable_cache();
+	_end_instruction();
 
 	return true;
 }
 
 bool Adafruit_QSPI_SAMD::runCommand(uint8_t command)
 {
-	uint32_t iframe = QSPI_INSTRFRAME_WIDTH_SINGLE_BIT_SPI | QSPI_INSTRFRAME_ADDRLEN_24BITS |
+  qspi_trace_scope trace(QSPI_TRACE_RUN_COMMAND, command, 0, 0);
+
+	uint32_t iframe = _command_width() | QSPI_INSTRFRAME_ADDRLEN_24BITS |
                     QSPI_INSTRFRAME_TFRTYPE_READ | QSPI_INSTRFRAME_INSTREN;
 
 	return _run_instruction(command, iframe, 0, NULL, 0);
@@ -138,7 +603,9 @@ bool Adafruit_QSPI_SAMD::runCommand(uint8_t command)
 
 bool Adafruit_QSPI_SAMD::readCommand(uint8_t command, uint8_t* response, uint32_t len)
 {
-  uint32_t iframe = QSPI_INSTRFRAME_WIDTH_SINGLE_BIT_SPI | QSPI_INSTRFRAME_ADDRLEN_24BITS |
+  qspi_trace_scope trace(QSPI_TRACE_READ_COMMAND, command, 0, len);
+
+  uint32_t iframe = _command_width() | QSPI_INSTRFRAME_ADDRLEN_24BITS |
                     QSPI_INSTRFRAME_TFRTYPE_READ | QSPI_INSTRFRAME_INSTREN | QSPI_INSTRFRAME_DATAEN;
 
   return _run_instruction(command, iframe, 0, response, len);
@@ -146,7 +613,9 @@ bool Adafruit_QSPI_SAMD::readCommand(uint8_t command, uint8_t* response, uint32_
 
 bool Adafruit_QSPI_SAMD::writeCommand(uint8_t command, uint8_t const* data, uint32_t len)
 {
-	uint32_t iframe = QSPI_INSTRFRAME_WIDTH_SINGLE_BIT_SPI | QSPI_INSTRFRAME_ADDRLEN_24BITS |
+  qspi_trace_scope trace(QSPI_TRACE_WRITE_COMMAND, command, qspi_trace_command_data(data, len), len);
+
+	uint32_t iframe = _command_width() | QSPI_INSTRFRAME_ADDRLEN_24BITS |
 	                  QSPI_INSTRFRAME_TFRTYPE_WRITE | QSPI_INSTRFRAME_INSTREN | (data != NULL ? QSPI_INSTRFRAME_DATAEN : 0);
 
 	return _run_instruction(command, iframe, 0, (uint8_t*) data, len);
@@ -154,8 +623,10 @@ bool Adafruit_QSPI_SAMD::writeCommand(uint8_t command, uint8_t const* data, uint
 
 bool Adafruit_QSPI_SAMD::eraseCommand(uint8_t command, uint32_t address)
 {
+  qspi_trace_scope trace(QSPI_TRACE_ERASE_COMMAND, command, address, 0);
+
 	// Sector Erase
-	uint32_t iframe = QSPI_INSTRFRAME_WIDTH_SINGLE_BIT_SPI | QSPI_INSTRFRAME_ADDRLEN_24BITS |
+	uint32_t iframe = _command_width() | _address_length() |
                     QSPI_INSTRFRAME_TFRTYPE_WRITE | QSPI_INSTRFRAME_INSTREN | QSPI_INSTRFRAME_ADDREN;
 
 	return _run_instruction(command, iframe, address, NULL, 0);
@@ -163,21 +634,110 @@ bool Adafruit_QSPI_SAMD::eraseCommand(uint8_t command, uint32_t address)
 
 bool Adafruit_QSPI_SAMD::readMemory(uint32_t addr, uint8_t *data, uint32_t len)
 {
-  // Command 0x6B 1 line address, 4 line Data
-  // with Continuous Read Mode and Quad output mode, read memory type
-  uint32_t iframe = QSPI_INSTRFRAME_WIDTH_QUAD_OUTPUT | QSPI_INSTRFRAME_ADDRLEN_24BITS |
-                    QSPI_INSTRFRAME_TFRTYPE_READMEMORY | QSPI_INSTRFRAME_INSTREN | QSPI_INSTRFRAME_ADDREN | QSPI_INSTRFRAME_DATAEN |
-                    /*QSPI_INSTRFRAME_CRMODE |*/ QSPI_INSTRFRAME_DUMMYLEN(8);
+  qspi_trace_scope trace(QSPI_TRACE_READ_MEMORY, 0, addr, len);
+
+  while ( len )
+  {
+    uint32_t count = min(len, (uint32_t) QSPI_DMA_CHUNK_LEN);
+    bool ok;
+
+    if ( addr < QSPI_AHB_WINDOW_SIZE )
+    {
+      count = min(count, QSPI_AHB_WINDOW_SIZE - addr);
+      ok = _run_instruction(_read_command, _read_frame, addr, data, count);
+    }
+    else
+    {
+      ok = _run_instruction(_far_read_command, _far_read_frame, addr, data, count);
+    }
+
+    if ( !ok ) return false;
+
+    addr += count;
+    data += count;
+    len  -= count;
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// Asynchronous read
+// The instruction is left open while DMA moves the data, task() then closes
+// it and continues with the next chunk if any.
+//--------------------------------------------------------------------+
+
+void Adafruit_QSPI_SAMD::_async_read_chunk(void)
+{
+  uint32_t const count = min(_async_remain, (uint32_t) QSPI_DMA_CHUNK_LEN);
 
-  return _run_instruction(QSPI_CMD_QUAD_READ, iframe, addr, data, len);
+  _start_instruction(_read_command, _read_frame, _async_addr);
+  _dma_start(_async_buf, ((uint8_t*) QSPI_AHB) + _async_addr, count);
+
+  _async_addr   += count;
+  _async_buf    += count;
+  _async_remain -= count;
+  _async_dma     = true;
+}
+
+// Return true once all data of the asynchronous read is in the buffer
+bool Adafruit_QSPI_SAMD::_async_read_poll(void)
+{
+  if ( !_dma_complete() ) return false;
+
+  _end_instruction();
+  _async_dma = false;
+
+  if ( !_async_remain ) return true;
+
+  _async_read_chunk();
+  return false;
+}
+
+bool Adafruit_QSPI_SAMD::readMemoryAsync(uint32_t addr, uint8_t *data, uint32_t len, qspi_callback_t cb, void* arg)
+{
+  if ( busy() ) return false;
+
+  // Too small to be worth a DMA transfer, or beyond the window
+  if ( len < QSPI_DMA_MIN_LEN || (uint64_t) addr + len > QSPI_AHB_WINDOW_SIZE )
+  {
+    return Adafruit_QSPI::readMemoryAsync(addr, data, len, cb, arg);
+  }
+
+  _async_addr   = addr;
+  _async_buf    = data;
+  _async_remain = len;
+  _async_read_chunk();
+
+  _async_begin(false, cb, arg);
+  return true;
+}
+
+bool Adafruit_QSPI_SAMD::_async_xfer_complete(bool* result)
+{
+  *result = true;
+  return !_async_dma || _async_read_poll();
 }
 
 bool Adafruit_QSPI_SAMD::writeMemory(uint32_t addr, uint8_t *data, uint32_t len)
 {
-  uint32_t iframe = QSPI_INSTRFRAME_WIDTH_QUAD_OUTPUT | QSPI_INSTRFRAME_ADDRLEN_24BITS |
-                    QSPI_INSTRFRAME_TFRTYPE_WRITEMEMORY | QSPI_INSTRFRAME_INSTREN | QSPI_INSTRFRAME_ADDREN | QSPI_INSTRFRAME_DATAEN;
+  qspi_trace_scope trace(QSPI_TRACE_WRITE_MEMORY, 0, addr, len);
+
+  if ( addr >= QSPI_AHB_WINDOW_SIZE ) return _run_instruction(_write_command, _far_write_frame, addr, data, len);
+
+  return _run_instruction(_write_command, _write_frame, addr, data, len);
+}
+
+bool Adafruit_QSPI_SAMD::readSFDP(uint32_t addr, uint8_t* data, uint32_t len)
+{
+  if ( _qpi ) return false;
+
+  // Register transfer: address comes from INSTRADDR, always 3 bytes
+  uint32_t iframe = QSPI_INSTRFRAME_WIDTH_SINGLE_BIT_SPI | QSPI_INSTRFRAME_ADDRLEN_24BITS |
+                    QSPI_INSTRFRAME_TFRTYPE_READ | QSPI_INSTRFRAME_INSTREN | QSPI_INSTRFRAME_ADDREN |
+                    QSPI_INSTRFRAME_DATAEN | QSPI_INSTRFRAME_DUMMYLEN(8);
 
-  return _run_instruction(QSPI_CMD_QUAD_PAGE_PROGRAM, iframe, addr, data, len);
+  return _run_instruction(QSPI_CMD_READ_SFDP, iframe, addr, data, len);
 }
 
 /**************************************************************************/
@@ -189,11 +749,15 @@ bool Adafruit_QSPI_SAMD::writeMemory(uint32_t addr, uint8_t *data, uint32_t len)
 void Adafruit_QSPI_SAMD::setClockDivider(uint8_t uc_div)
 {
 	QSPI->BAUD.bit.BAUD = uc_div;
+
+  qspi_trace_config(QSPI_TRACE_SET_CLOCK, VARIANT_MCK/(uc_div + 1), 0);
 }
 
 void Adafruit_QSPI_SAMD::setClockSpeed(uint32_t clock_hz)
 {
   QSPI->BAUD.bit.BAUD = VARIANT_MCK/clock_hz;
+
+  qspi_trace_config(QSPI_TRACE_SET_CLOCK, VARIANT_MCK/(QSPI->BAUD.bit.BAUD + 1), 0);
 }
 
 #endif
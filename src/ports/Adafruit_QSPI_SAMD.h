@@ -20,6 +20,14 @@
 #include "SPI.h"
 #include <Arduino.h>
 
+/// CMCC cache policy, see Adafruit_QSPI_SAMD::setCachePolicy()
+enum
+{
+  QSPI_CACHE_FLUSH_ALWAYS = 0, ///< disable and invalidate cache around every instruction
+  QSPI_CACHE_FLUSH_ON_WRITE,   ///< keep instruction cache enabled, invalidate only after program/erase.
+                               ///< Disables the data cache system-wide.
+};
+
 /**************************************************************************/
 /*! 
     @brief  Class for interfacing with QSPI hardware
@@ -34,6 +42,7 @@ public:
 	virtual void begin(int sck, int cs, int io0, int io1, int io2, int io3);
 	using Adafruit_QSPI::begin;
 
+	/// Disable the QSPI, gate its clocks and release the pins
 	void end(void);
 
 	virtual void setClockDivider(uint8_t uc_div);
@@ -46,11 +55,79 @@ public:
 	virtual bool eraseCommand(uint8_t command, uint32_t address);
 	virtual bool readMemory(uint32_t addr, uint8_t *data, uint32_t len);
 	virtual bool writeMemory(uint32_t addr, uint8_t *data, uint32_t len);
+	virtual bool readSFDP(uint32_t addr, uint8_t* data, uint32_t len);
+
+	using Adafruit_QSPI::writeMemoryAsync;
+	using Adafruit_QSPI::eraseCommandAsync;
+	using Adafruit_QSPI::busy;
+	using Adafruit_QSPI::task;
+	using Adafruit_QSPI::hasReadyWait;
+	using Adafruit_QSPI::waitReady;
+
+	virtual bool readMemoryAsync(uint32_t addr, uint8_t *data, uint32_t len, qspi_callback_t cb, void* arg);
+
+	virtual uint8_t const* mapMemory(uint32_t addr, uint32_t len);
+	virtual void unmapMemory(void);
+
+	virtual bool setAddressLength(uint8_t bits);
+	virtual bool setContinuousReadMode(uint8_t mode_bits);
+	virtual bool setReadMode(uint8_t xfer_mode, uint8_t dummy_cycles);
+	virtual bool setWriteMode(uint8_t xfer_mode);
+	virtual bool setQPI(bool enable);
+
+	void setCachePolicy(uint8_t policy);
+
+protected:
+	virtual bool _async_xfer_complete(bool* result);
 
 private:
+	int      _pins[6]; // sck, cs, io0-io3 given to begin(), -1 if not started
+
+	// asynchronous read in progress
+	uint32_t _async_addr;
+	uint8_t* _async_buf;
+	uint32_t _async_remain;
+	bool     _async_dma;
+
+	uint8_t  _cache_policy;
+	bool     _flush_on_end;
+
+	bool     _mapped;
+
+	// transfer modes, continuous read mode if _crm_bits is not zero
+	bool     _qpi;
+	uint8_t  _read_mode;
+	uint8_t  _read_dummy;
+	uint8_t  _write_mode;
+	uint8_t  _crm_bits;
+	bool     _crm_active;
+	bool     _addr32;
+
+	// memory read/write instructions computed from the modes
+	uint8_t  _read_command;
+	uint32_t _read_frame;
+	uint8_t  _write_command;
+	uint32_t _write_frame;
+
+	// register transfers beyond the 16 MiB QSPI_AHB window
+	uint8_t  _far_read_command;
+	uint32_t _far_read_frame;
+	uint32_t _far_write_frame;
+
+	void _start_instruction(uint8_t command, uint32_t iframe, uint32_t addr);
+	void _end_instruction(void);
+	void _enter_memory_mode(void);
+	void _exit_continuous_read(void);
+	void _update_memory_frames(void);
+	uint32_t _command_width(void) { return _qpi ? QSPI_INSTRFRAME_WIDTH_QUAD_CMD : QSPI_INSTRFRAME_WIDTH_SINGLE_BIT_SPI; }
+	uint32_t _address_length(void) { return _addr32 ? QSPI_INSTRFRAME_ADDRLEN_32BITS : QSPI_INSTRFRAME_ADDRLEN_24BITS; }
 	bool _run_instruction(uint8_t command, uint32_t ifr, uint32_t addr, uint8_t *buffer, uint32_t size);
+
+	void _async_read_chunk(void);
+	bool _async_read_poll(void);
 };
 
 extern Adafruit_QSPI_SAMD QSPI0; ///< default QSPI instance
+typedef Adafruit_QSPI_SAMD Adafruit_QSPI_Port; ///< port class of QSPI0
 
 #endif